@@ -2,16 +2,68 @@
 #include <chrono>
 
 ImageGraph::ImageGraph(const std::string &imageFilename, const std::string &maskFilename):
-    _imageArray(),
+    _ownImage(),
+    _imageArray(_ownImage),
+    _cutImage(),
+    _pixelMask(_ownPixelMask),
     _graph(),
     _costs(_graph),
     _coordinates(_graph),
     _maxBoundaryPenalty(0.0f),
     _lambda(1.0f),
-    _sigma(1.0f)
+    _sigma(1.0f),
+    _loggingEnabled(true)
 {
     loadImage(imageFilename);
     _pixelMask = PixelMask(maskFilename, &_imageArray);
+    logModel();
+}
+
+ImageGraph::ImageGraph(const ImageArray &image, const ImageArray &mask):
+    _ownImage(image),
+    _imageArray(_ownImage),
+    _cutImage(),
+    _pixelMask(_ownPixelMask),
+    _graph(),
+    _costs(_graph),
+    _coordinates(_graph),
+    _maxBoundaryPenalty(0.0f),
+    _lambda(1.0f),
+    _sigma(1.0f),
+    _loggingEnabled(true)
+{
+    _pixelMask = PixelMask(mask, &_imageArray);
+    logModel();
+}
+
+ImageGraph::ImageGraph(const ImageArray &image, const ImageArray &mask, const PixelMask::RegionModel &model):
+    _ownImage(image),
+    _imageArray(_ownImage),
+    _cutImage(),
+    _pixelMask(_ownPixelMask),
+    _graph(),
+    _costs(_graph),
+    _coordinates(_graph),
+    _maxBoundaryPenalty(0.0f),
+    _lambda(1.0f),
+    _sigma(1.0f),
+    _loggingEnabled(true)
+{
+    _pixelMask = PixelMask(mask, &_imageArray, model);
+}
+
+ImageGraph::ImageGraph(ImageGraph *parent):
+    _imageArray(parent->_imageArray),
+    _cutImage(),
+    _pixelMask(parent->_pixelMask),
+    _graph(),
+    _costs(_graph),
+    _coordinates(_graph),
+    _maxBoundaryPenalty(0.0f),
+    _lambda(parent->_lambda),
+    _sigma(parent->_sigma),
+    _loggingEnabled(parent->_loggingEnabled)
+{
 }
 
 
@@ -45,6 +97,90 @@ void ImageGraph::loadImage(const std::string& filename)
 }
 
 
+void ImageGraph::addSeeds(const std::vector<Coordinate>& pixels, PixelMask::PixelType type)
+{
+    for(const Coordinate& c : pixels)
+    {
+        _pixelMask.setPixelType(c.first, c.second, type);
+    }
+    _pixelMask.updateModel();
+    logModel();
+}
+
+const PixelMask& ImageGraph::pixelMask() const
+{
+    return _pixelMask;
+}
+
+void ImageGraph::copyModel(const PixelMask& pixelMask)
+{
+    _pixelMask.copyModel(pixelMask);
+}
+
+void ImageGraph::setLoggingEnabled(bool enableLog)
+{
+    _loggingEnabled = enableLog;
+}
+
+void ImageGraph::logModel() const
+{
+    if(!_loggingEnabled)
+        return;
+
+    PixelMask::RegionModel model = _pixelMask.regionModel();
+    std::cout << "Background statistics: mean=" << model.backgroundMean << " variance=" << model.backgroundVariance << std::endl;
+    std::cout << "Foreground statistics: mean=" << model.foregroundMean << " variance=" << model.foregroundVariance << std::endl;
+}
+
+const ImageGraph::ImageArray& ImageGraph::image() const
+{
+    return _imageArray;
+}
+
+const ImageGraph::ImageArray& ImageGraph::cutImage() const
+{
+    return _cutImage;
+}
+
+const ImageGraph::Box& ImageGraph::changedBox() const
+{
+    return _changedBox;
+}
+
+void ImageGraph::beginCutUpdate()
+{
+    _changedMin = Coordinate(_cutImage.shape(0), _cutImage.shape(1));
+    _changedMax = Coordinate(0, 0);
+}
+
+void ImageGraph::endCutUpdate()
+{
+    if(_changedMin.first < _changedMax.first)
+        _changedBox = std::make_pair(_changedMin, _changedMax);
+    else
+        _changedBox = Box();
+}
+
+const ImageGraph::ImageArray& ImageGraph::runIterativeMinCut(unsigned int numRounds)
+{
+    runMinCut();
+
+    for(unsigned int round = 1; round < numRounds; round++)
+    {
+        reestimateModel(_cutImage);
+        buildGraph();
+        runMinCut();
+    }
+
+    return _cutImage;
+}
+
+void ImageGraph::reestimateModel(const ImageArray& labels)
+{
+    _pixelMask.reestimateModel(labels);
+    logModel();
+}
+
 float ImageGraph::sigma() const
 {
     return _sigma;
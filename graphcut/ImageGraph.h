@@ -5,6 +5,7 @@
 #include <vector>
 #include <tuple>
 #include <algorithm>
+#include <cstdint>
 
 // vigra includes
 #include <vigra/impex.hxx>
@@ -29,13 +30,40 @@ class ImageGraph {
 public:
     typedef vigra::MultiArray<2, vigra::UInt8> ImageArray;
     typedef std::pair<unsigned int, unsigned int> Coordinate;
+    // axis aligned box from first (inclusive) to second (exclusive)
+    typedef std::pair<Coordinate, Coordinate> Box;
 
 public:
     ImageGraph(const std::string &imageFilename, const std::string &maskFilename);
+    // in-memory variant for embedding, image and mask are copied
+    ImageGraph(const ImageArray &image, const ImageArray &mask);
+    // same with a given region model instead of one estimated from the seeds, see PixelMask
+    ImageGraph(const ImageArray &image, const ImageArray &mask, const PixelMask::RegionModel& model);
     virtual ~ImageGraph();
 
+protected:
+    // subproblem of another graph: uses the image and pixel mask (seeds and region model) of
+    // the parent instead of copying them and computing the statistics again. The parent has
+    // to outlive the subproblem, seeds and models are changed through the parent.
+    explicit ImageGraph(ImageGraph* parent);
+
+public:
+
     virtual void buildGraph() = 0;
-    virtual ImageArray runMinCut() = 0;
+    // the returned image is owned by the graph and overwritten by the next cut
+    virtual const ImageArray& runMinCut() = 0;
+    // allocate graph and solver storage for an image of the given size up front
+    virtual void reserve(unsigned int width, unsigned int height) = 0;
+
+    const ImageArray& image() const;
+    // result of the last runMinCut()
+    const ImageArray& cutImage() const;
+    // bounding box of the pixels whose label changed in the last runMinCut(), empty if none did
+    const Box& changedBox() const;
+
+    // GrabCut style: after each cut, re-estimate the region models from its labels and cut again
+    const ImageArray& runIterativeMinCut(unsigned int numRounds);
+    virtual void reestimateModel(const ImageArray& labels);
 
     float lambda() const;
     virtual void setLambda(float lambda);
@@ -43,16 +71,45 @@ public:
     float sigma() const;
     virtual void setSigma(float sigma);
 
+    // turn the given pixels into seeds of the given type, e.g. from a user scribble.
+    // The next runMinCut() only updates what these pixels change if the graph supports it.
+    virtual void addSeeds(const std::vector<Coordinate>& pixels, PixelMask::PixelType type);
+
+    const PixelMask& pixelMask() const;
+    // use the region models of another mask over the same image
+    void copyModel(const PixelMask& pixelMask);
+
+    // progress and timing output on std::cout, on by default
+    void setLoggingEnabled(bool enableLog);
+
 private:
     void loadImage(const std::string& filename);
+    void logModel() const;
 
 protected:
-    ImageArray _imageArray;
-    PixelMask _pixelMask;
+    // write labels into the result image between these calls to keep track of the changed box
+    void beginCutUpdate();
+    inline void updateCutLabel(unsigned int x, unsigned int y, vigra::UInt8 label);
+    void endCutUpdate();
 
+private:
+    // only used if this graph is not a subproblem of another one
+    ImageArray _ownImage;
+    PixelMask _ownPixelMask;
+
+protected:
+    ImageArray& _imageArray;
+    ImageArray _cutImage;
+    Box _changedBox;
+    Coordinate _changedMin;
+    Coordinate _changedMax;
+    PixelMask& _pixelMask;
+
+    // terminal cost of a seed
     float _maxBoundaryPenalty;
     float _lambda;
     float _sigma;
+    bool _loggingEnabled;
 
     Graph _graph;
     EdgeMap _costs;
@@ -61,5 +118,17 @@ protected:
     Graph::Node _sinkNode;
 };
 
+void ImageGraph::updateCutLabel(unsigned int x, unsigned int y, vigra::UInt8 label)
+{
+    vigra::UInt8& pixel = _cutImage(x, y);
+    if(pixel != label)
+    {
+        pixel = label;
+        _changedMin.first = std::min(_changedMin.first, x);
+        _changedMin.second = std::min(_changedMin.second, y);
+        _changedMax.first = std::max(_changedMax.first, x + 1);
+        _changedMax.second = std::max(_changedMax.second, y + 1);
+    }
+}
 
 #endif // IMAGEGRAPH_H
@@ -0,0 +1,325 @@
+#include "ImageGraphBatch.h"
+#include "ImageGraphPrimal.h"
+#include "Parallel.h"
+#include <chrono>
+#include <cstdlib>
+
+struct ImageGraphBatch::Workspace
+{
+    Workspace():
+        costs(graph),
+        preflow(NULL),
+        width(0),
+        height(0)
+    {}
+
+    ~Workspace()
+    {
+        delete preflow;
+    }
+
+    // same nodes and edges as ImageGraphPrimal, only rebuilt if the size changes
+    void setShape(unsigned int newWidth, unsigned int newHeight)
+    {
+        if(preflow && newWidth == width && newHeight == height)
+            return;
+
+        width = newWidth;
+        height = newHeight;
+        delete preflow;
+        graph.clear();
+
+        graph.reserveNode(width * height + 2);
+        graph.reserveEdge(6 * width * height);
+
+        nodes.resize(width * height);
+        std::generate(nodes.begin(), nodes.end(), [&]() { return graph.addNode(); });
+        sinkNode = graph.addNode();
+        sourceNode = graph.addNode();
+
+        boundaryEdges.clear();
+        ImageGraphPrimal::forEachNeighborPair(width, height, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+        {
+            boundaryEdges.push_back(graph.addEdge(nodes[y0 * width + x0], nodes[y1 * width + x1]));
+        });
+
+        sourceEdges.resize(width * height);
+        sinkEdges.resize(width * height);
+        for(unsigned int i = 0; i < width * height; i++)
+        {
+            sourceEdges[i] = graph.addEdge(nodes[i], sourceNode);
+            sinkEdges[i] = graph.addEdge(nodes[i], sinkNode);
+        }
+
+        preflow = new lemon::Preflow< Graph, EdgeMap >(graph, costs, sourceNode, sinkNode);
+    }
+
+    Graph graph;
+    EdgeMap costs;
+    std::vector<Graph::Node> nodes;
+    std::vector<Edge> boundaryEdges;
+    std::vector<Edge> sourceEdges;
+    std::vector<Edge> sinkEdges;
+    Graph::Node sourceNode;
+    Graph::Node sinkNode;
+    lemon::Preflow< Graph, EdgeMap > *preflow;
+    unsigned int width;
+    unsigned int height;
+
+    // per pixel of the current problem the summed penalties of its edges
+    std::vector<float> incidentPenalties;
+
+    // terms of the current problem, by absolute intensity difference and by intensity
+    float gradientPenalty[256];
+    float foregroundPenalty[256];
+    float backgroundPenalty[256];
+};
+
+ImageGraphBatch::ImageGraphBatch():
+    _maxWidth(0),
+    _maxHeight(0),
+    _loggingEnabled(false)
+{
+}
+
+ImageGraphBatch::~ImageGraphBatch()
+{
+    for(Workspace* workspace : _workspaces)
+        delete workspace;
+}
+
+void ImageGraphBatch::reserve(unsigned int numProblems, unsigned int numPixels)
+{
+    _pixels.reserve(numPixels);
+    _seeds.reserve(numPixels);
+
+    _offsets.reserve(numProblems);
+    _order.reserve(numProblems);
+    _widths.reserve(numProblems);
+    _heights.reserve(numProblems);
+    _lambdas.reserve(numProblems);
+    _sigmas.reserve(numProblems);
+    _backgroundMeans.reserve(numProblems);
+    _backgroundVariances.reserve(numProblems);
+    _foregroundMeans.reserve(numProblems);
+    _foregroundVariances.reserve(numProblems);
+}
+
+void ImageGraphBatch::clear()
+{
+    _pixels.clear();
+    _seeds.clear();
+
+    _offsets.clear();
+    _widths.clear();
+    _heights.clear();
+    _lambdas.clear();
+    _sigmas.clear();
+    _backgroundMeans.clear();
+    _backgroundVariances.clear();
+    _foregroundMeans.clear();
+    _foregroundVariances.clear();
+
+    _maxWidth = 0;
+    _maxHeight = 0;
+}
+
+unsigned int ImageGraphBatch::addProblem(const ImageView &image, const ImageView &mask, float lambda, float sigma)
+{
+    vigra_precondition(image.shape() == mask.shape(), "ImageGraphBatch::addProblem: mask and image must have the same shape");
+
+    unsigned int width = image.shape(0);
+    unsigned int height = image.shape(1);
+
+    // pack the problem and sum up the seed intensities on the way, exactly in integers
+    uint64_t numPixels[2] = { 0, 0 };
+    uint64_t sums[2] = { 0, 0 };
+    uint64_t squaredSums[2] = { 0, 0 };
+
+    _offsets.push_back(_pixels.size());
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            vigra::UInt8 pixelValue = image(x, y);
+            vigra::UInt8 seed = mask(x, y);
+            _pixels.push_back(pixelValue);
+            _seeds.push_back(seed);
+
+            if(seed == PixelMask::FOREGROUND || seed == PixelMask::BACKGROUND)
+            {
+                unsigned int c = (seed == PixelMask::FOREGROUND);
+                numPixels[c]++;
+                sums[c] += pixelValue;
+                squaredSums[c] += pixelValue * pixelValue;
+            }
+        }
+    }
+
+    if(numPixels[0] < 2 || numPixels[1] < 2)
+    {
+        _pixels.resize(_offsets.back());
+        _seeds.resize(_offsets.back());
+        _offsets.pop_back();
+        vigra_fail("ImageGraphBatch::addProblem: both classes need at least two seeds");
+    }
+
+    // mean and unbiased variance, computed like PixelMask
+    float means[2];
+    float variances[2];
+    for(unsigned int c = 0; c < 2; c++)
+    {
+        double n = numPixels[c];
+        double m2 = squaredSums[c] - (double)sums[c] * sums[c] / n;
+        means[c] = sums[c] / n;
+        variances[c] = std::max(MIN_CLASS_VARIANCE, (float)(std::max(0.0, m2) / (n - 1.0)));
+    }
+
+    _widths.push_back(width);
+    _heights.push_back(height);
+    _lambdas.push_back(lambda);
+    _sigmas.push_back(sigma);
+    _backgroundMeans.push_back(means[0]);
+    _backgroundVariances.push_back(variances[0]);
+    _foregroundMeans.push_back(means[1]);
+    _foregroundVariances.push_back(variances[1]);
+
+    _maxWidth = std::max(_maxWidth, width);
+    _maxHeight = std::max(_maxHeight, height);
+
+    return _offsets.size() - 1;
+}
+
+unsigned int ImageGraphBatch::numProblems() const
+{
+    return _offsets.size();
+}
+
+vigra::Shape2 ImageGraphBatch::shape(unsigned int problem) const
+{
+    return vigra::Shape2(_widths[problem], _heights[problem]);
+}
+
+void ImageGraphBatch::solveProblem(Workspace &workspace, unsigned int problem)
+{
+    unsigned int width = _widths[problem];
+    unsigned int height = _heights[problem];
+    workspace.setShape(width, height);
+
+    const vigra::UInt8* pixels = &_pixels[_offsets[problem]];
+    const vigra::UInt8* seeds = &_seeds[_offsets[problem]];
+    float lambda = _lambdas[problem];
+    float sigma = _sigmas[problem];
+    float foregroundMean = _foregroundMeans[problem];
+    float foregroundVariance = _foregroundVariances[problem];
+    float backgroundMean = _backgroundMeans[problem];
+    float backgroundVariance = _backgroundVariances[problem];
+
+    // the same terms as ImageGraphPrimal and PixelMask, tabulated once per problem
+    for(unsigned int v = 0; v < 256; v++)
+    {
+        float p = (float)v;
+        workspace.gradientPenalty[v] = 100.0f * expf(-(p * p) / (2.0f * powf(sigma,2.0f)));
+        workspace.foregroundPenalty[v] = lambda * (powf(foregroundMean - p, 2.0f) / (2.0f * foregroundVariance) + logf(sqrtf(2.0f * M_PI * foregroundVariance)));
+        workspace.backgroundPenalty[v] = lambda * (powf(backgroundMean - p, 2.0f) / (2.0f * backgroundVariance) + logf(sqrtf(2.0f * M_PI * backgroundVariance)));
+    }
+
+    // seeds outweigh all edges of any pixel, like in ImageGraphPrimal
+    workspace.incidentPenalties.assign(width * height, 0.0f);
+    std::vector<Edge>::const_iterator edge = workspace.boundaryEdges.begin();
+    ImageGraphPrimal::forEachNeighborPair(width, height, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+    {
+        int difference = pixels[y0 * width + x0] - pixels[y1 * width + x1];
+        float distance = (x0 == x1 || y0 == y1) ? 1.0f : sqrtf(2.0f);
+        float penalty = workspace.gradientPenalty[std::abs(difference)] / distance;
+
+        workspace.incidentPenalties[y0 * width + x0] += penalty;
+        workspace.incidentPenalties[y1 * width + x1] += penalty;
+        workspace.costs[*edge++] = penalty;
+    });
+
+    float maxBoundaryPenalty = 0.0f;
+    for(float incidentPenalty : workspace.incidentPenalties)
+        maxBoundaryPenalty = std::max(maxBoundaryPenalty, incidentPenalty);
+    maxBoundaryPenalty += 1.0f;
+
+    for(unsigned int i = 0; i < width * height; i++)
+    {
+        vigra::UInt8 pixelValue = pixels[i];
+        float sourceCost = workspace.backgroundPenalty[pixelValue];
+        float sinkCost = workspace.foregroundPenalty[pixelValue];
+
+        if(seeds[i] == PixelMask::FOREGROUND)
+        {
+            sourceCost = maxBoundaryPenalty;
+            sinkCost = 0.0f;
+        }
+        else if(seeds[i] == PixelMask::BACKGROUND)
+        {
+            sourceCost = 0.0f;
+            sinkCost = maxBoundaryPenalty;
+        }
+
+        workspace.costs[workspace.sourceEdges[i]] = sourceCost;
+        workspace.costs[workspace.sinkEdges[i]] = sinkCost;
+    }
+
+    workspace.preflow->runMinCut();
+
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            _labels(x, y, problem) = workspace.preflow->minCut(workspace.nodes[y * width + x]) ? 255 : 0;
+        }
+    }
+}
+
+void ImageGraphBatch::solve(unsigned int numThreads)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    unsigned int numProblems = _offsets.size();
+
+    if(numThreads == 0)
+        numThreads = numWorkerThreads();
+    numThreads = std::max(1u, std::min(numThreads, numProblems));
+
+    // workspaces stay allocated for the next batch
+    while(_workspaces.size() < numThreads)
+        _workspaces.push_back(new Workspace());
+
+    _labels.reshape(vigra::Shape3(_maxWidth, _maxHeight, numProblems), 0);
+
+    // Problems are handed out by size. Every thread takes them in increasing position, so it
+    // rebuilds its graph at most once per distinct size instead of whenever the size alternates.
+    _order.resize(numProblems);
+    for(unsigned int problem = 0; problem < numProblems; problem++)
+        _order[problem] = problem;
+    std::sort(_order.begin(), _order.end(), [&](unsigned int a, unsigned int b)
+    {
+        return std::make_tuple(_widths[a], _heights[a], a) < std::make_tuple(_widths[b], _heights[b], b);
+    });
+
+    parallelForDynamic(0, numProblems, numThreads, [&](unsigned int thread, unsigned int i)
+    {
+        solveProblem(*_workspaces[thread], _order[i]);
+    });
+
+    if(_loggingEnabled)
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+        std::cout << "Solved " << numProblems << " problems (" << _pixels.size() << " pixels) on " << numThreads
+                  << " threads in " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
+    }
+}
+
+const ImageGraphBatch::LabelTensor& ImageGraphBatch::labels() const
+{
+    return _labels;
+}
+
+void ImageGraphBatch::setLoggingEnabled(bool enableLog)
+{
+    _loggingEnabled = enableLog;
+}
@@ -0,0 +1,79 @@
+#ifndef IMAGEGRAPHBATCH_H
+#define IMAGEGRAPHBATCH_H
+
+#include <vector>
+#include <vigra/multi_array.hxx>
+
+/**
+ * Solves many small independent segmentation problems (e.g. thumbnails or patches) at once.
+ *
+ * Images and seed masks of all problems are packed into one contiguous workspace, their
+ * parameters and region models are stored as one array per field. solve() cuts them in
+ * parallel, ordered by size, and every thread reuses its own graph and solver as long as
+ * consecutive problems have the same size, so only a change of size allocates.
+ * The cuts use the same energy as ImageGraphPrimal.
+ */
+class ImageGraphBatch
+{
+public:
+    typedef vigra::MultiArrayView<2, vigra::UInt8> ImageView;
+    // labels of problem i in [0, width_i) x [0, height_i) x {i}, 0 or 255, padded with 0
+    typedef vigra::MultiArray<3, vigra::UInt8> LabelTensor;
+
+public:
+    ImageGraphBatch();
+    ~ImageGraphBatch();
+
+    // allocate the workspace for the given number of problems and pixels of all problems together
+    void reserve(unsigned int numProblems, unsigned int numPixels);
+    // remove all problems, keeps the allocated workspace
+    void clear();
+
+    // copy a problem into the workspace and return its index. The mask uses the PixelMask values,
+    // both classes need at least two seeds to estimate their model. Like in PixelMask, the variance
+    // of a class is at least MIN_CLASS_VARIANCE, e.g. if all its seeds have the same intensity.
+    unsigned int addProblem(const ImageView& image, const ImageView& mask, float lambda, float sigma);
+    unsigned int numProblems() const;
+    vigra::Shape2 shape(unsigned int problem) const;
+
+    // cut all problems on numThreads threads, 0 uses all cores
+    void solve(unsigned int numThreads = 0);
+    // result of the last solve()
+    const LabelTensor& labels() const;
+
+    // timing of each solve() on std::cout, off by default
+    void setLoggingEnabled(bool enableLog);
+
+private:
+    // graph and solver of one thread, reused for all problems of the same size
+    struct Workspace;
+
+    void solveProblem(Workspace& workspace, unsigned int problem);
+
+private:
+    // pixels and seeds of all problems, one after the other
+    std::vector<vigra::UInt8> _pixels;
+    std::vector<vigra::UInt8> _seeds;
+
+    // per problem
+    std::vector<unsigned int> _offsets;
+    std::vector<unsigned int> _widths;
+    std::vector<unsigned int> _heights;
+    std::vector<float> _lambdas;
+    std::vector<float> _sigmas;
+    std::vector<float> _backgroundMeans;
+    std::vector<float> _backgroundVariances;
+    std::vector<float> _foregroundMeans;
+    std::vector<float> _foregroundVariances;
+
+    unsigned int _maxWidth;
+    unsigned int _maxHeight;
+
+    // problem indices sorted by size, so that threads rarely have to rebuild their graph
+    std::vector<unsigned int> _order;
+    std::vector<Workspace*> _workspaces;
+    LabelTensor _labels;
+    bool _loggingEnabled;
+};
+
+#endif // IMAGEGRAPHBATCH_H
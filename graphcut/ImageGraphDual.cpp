@@ -1,16 +1,46 @@
 #include "ImageGraphDual.h"
-#include <QtConcurrentRun>
 #include <chrono>
+#include <functional>
 
 ImageGraphDual::ImageGraphDual(const std::string &imageFilename,
                                const std::string &maskFilename):
     ImageGraph(imageFilename, maskFilename),
-    _subgraphM(imageFilename, maskFilename),
-    _subgraphN(imageFilename, maskFilename),
+    _subgraphM(this),
+    _subgraphN(this),
     _splitX(_imageArray.shape(0)/2),
     _lagrangians(_imageArray.shape(1), 0),
-    _numIterations(1)
+    _negatedLagrangians(_imageArray.shape(1), 0),
+    _numIterations(1),
+    _asynchronous(false),
+    _maxStaleness(2),
+    _numDisagreements(0)
 {
+    setupSubgraphs();
+}
+
+ImageGraphDual::ImageGraphDual(const ImageArray &image,
+                               const ImageArray &mask):
+    ImageGraph(image, mask),
+    _subgraphM(this),
+    _subgraphN(this),
+    _splitX(_imageArray.shape(0)/2),
+    _lagrangians(_imageArray.shape(1), 0),
+    _negatedLagrangians(_imageArray.shape(1), 0),
+    _numIterations(1),
+    _asynchronous(false),
+    _maxStaleness(2),
+    _numDisagreements(0)
+{
+    setupSubgraphs();
+}
+
+ImageGraphDual::~ImageGraphDual() {}
+
+void ImageGraphDual::setupSubgraphs()
+{
+    // both subgraphs use the image and pixel mask of this graph, which are loaded and
+    // whose statistics are computed only once
+
     // set up both subgraphs with overlap
     _subgraphM.setLoggingEnabled(false);
     _subgraphM.setRange(0, 0, _splitX + 1, _imageArray.shape(1));
@@ -19,9 +49,9 @@ ImageGraphDual::ImageGraphDual(const std::string &imageFilename,
     _subgraphN.setLoggingEnabled(false);
     _subgraphN.setRange(_splitX, 0, _imageArray.shape(0), _imageArray.shape(1));
     _subgraphN.setSplitX(_splitX);
-}
 
-ImageGraphDual::~ImageGraphDual() {}
+    _cutImage.reshape(_imageArray.shape(), 0);
+}
 
 void ImageGraphDual::buildGraph()
 {
@@ -29,90 +59,96 @@ void ImageGraphDual::buildGraph()
 
     _subgraphM.setLagrangians(_lagrangians);
 
-    std::vector<float> negativeLagrangians(_lagrangians);
-    std::transform(_lagrangians.begin(), _lagrangians.end(), negativeLagrangians.begin(), [](float x){return -x;});
-    _subgraphN.setLagrangians(negativeLagrangians);
+    std::transform(_lagrangians.begin(), _lagrangians.end(), _negatedLagrangians.begin(), [](float x){return -x;});
+    _subgraphN.setLagrangians(_negatedLagrangians);
 
     // build subgraphs in parallel
-    QFuture<void> fM = QtConcurrent::run(&_subgraphM, &ImageGraphPrimal::buildGraph);
-    QFuture<void> fN = QtConcurrent::run(&_subgraphN, &ImageGraphPrimal::buildGraph);
+    double scaleM = 0.0;
+    double scaleN = 0.0;
+    _subgraphM.setCapacityScale(0.0);
+    _subgraphN.setCapacityScale(0.0);
+    parallelInvoke(_workerN,
+                   [this, &scaleN]() { _subgraphN.buildGraph(); scaleN = _subgraphN.capacityScale(); },
+                   [this, &scaleM]() { _subgraphM.buildGraph(); scaleM = _subgraphM.capacityScale(); });
 
-    fM.waitForFinished();
-    fN.waitForFinished();
+    // with integer capacities both quantize with the same scale, so the seam costs they share round alike
+    if(scaleM > 0.0)
+    {
+        double scale = std::min(scaleM, scaleN);
+        _subgraphM.setCapacityScale(scale);
+        _subgraphN.setCapacityScale(scale);
+    }
 
-    auto end = std::chrono::high_resolution_clock::now();
-    auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
-    std::cout << "Building Graphs took: " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
+    if(_loggingEnabled)
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+        std::cout << "Building Graphs took: " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
+    }
 }
 
-ImageGraph::ImageArray ImageGraphDual::runMinCut()
+const ImageGraph::ImageArray& ImageGraphDual::runMinCut()
 {
     auto start = std::chrono::high_resolution_clock::now();
     auto sum = 0;
-    QFuture<ImageGraph::ImageArray> fM;
-    QFuture<ImageGraph::ImageArray> fN;
 
-    // loop for K iterations
-    for(auto iteration = 0; iteration < _numIterations; iteration++)
+    if(_asynchronous)
     {
-        if(iteration > 0)
-        {
-            buildGraph();
-        }
-
-        // find solution of subproblems in parallel
-        fM = QtConcurrent::run(&_subgraphM, &ImageGraphPrimal::runMinCut);
-        fN = QtConcurrent::run(&_subgraphN, &ImageGraphPrimal::runMinCut);
-
-        fM.waitForFinished();
-        fN.waitForFinished();
-
-        // check how much the results in the overlap differ
-        sum = 0;
-        for(auto i = 0; i < _lagrangians.size(); i++)
+        sum = runAsynchronous();
+    }
+    else
+    {
+        // loop for K iterations, cutting at least once so the result is never that of an earlier cut
+        unsigned int numIterations = std::max(1u, _numIterations);
+        for(unsigned int iteration = 0; iteration < numIterations; iteration++)
         {
-            bool nodeInSourceSetForM = _subgraphM.isNodeInSourceSubset(_splitX, i);
-            bool nodeInSourceSetForN = _subgraphN.isNodeInSourceSubset(_splitX, i);
-
-            if(nodeInSourceSetForM != nodeInSourceSetForN)
+            if(iteration > 0)
             {
-                std::cout << "Pixel (" << _splitX << ", " << i << ") disagrees!" << std::endl;
-                sum++;
+                buildGraph();
             }
-        }
 
-        if(sum == 0)
-        {
-            break;
-        }
+            // find solution of subproblems in parallel
+            parallelInvoke(_workerN,
+                           [this]() { _subgraphN.runMinCut(); },
+                           [this]() { _subgraphM.runMinCut(); });
 
-        // update lagrangians
-        std::cout << "\nIteration " << iteration << ": There were " << sum << " disagreeing pixels\n" << std::endl;
+            // check how much the results in the overlap differ, and update lagrangians where they do
+            sum = updateLagrangiansAtSeam();
 
-        for(auto i = 0; i < _lagrangians.size(); i++)
-        {
-            int nodeInSourceSetForM = _subgraphM.isNodeInSourceSubset(_splitX, i)?1:0;
-            int nodeInSourceSetForN = _subgraphN.isNodeInSourceSubset(_splitX, i)?1:0;
+            if(sum == 0)
+            {
+                break;
+            }
 
-            if(nodeInSourceSetForM != nodeInSourceSetForN)
+            if(_loggingEnabled)
             {
-                // stick to a stepsize of 1 for now
-                _lagrangians[i] -= 100 * (nodeInSourceSetForM - nodeInSourceSetForN);
+                std::cout << "\nIteration " << iteration << ": There were " << sum << " disagreeing pixels\n" << std::endl;
+
+                std::cout << "\tLagrangian: min=" << *(std::min_element(_lagrangians.begin(), _lagrangians.end()))
+                             << " max=" << *(std::max_element(_lagrangians.begin(), _lagrangians.end())) << std::endl;
             }
         }
-
-        std::cout << "\tLagrangian: min=" << *(std::min_element(_lagrangians.begin(), _lagrangians.end()))
-                     << " max=" << *(std::max_element(_lagrangians.begin(), _lagrangians.end())) << std::endl;
+        // loop end
     }
-    // loop end
 
-    std::cout << "\nEnd: There were " << sum << " disagreeing pixels\n" << std::endl;
+    if(_loggingEnabled)
+    {
+        std::cout << "\nEnd: There were " << sum << " disagreeing pixels\n" << std::endl;
+
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+        std::cout << "Solving with Dual Decomposition took: " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
+    }
 
-    auto end = std::chrono::high_resolution_clock::now();
-    auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
-    std::cout << "Solving with Dual Decomposition took: " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
+    _numDisagreements = sum;
+    mergeSolutions(_subgraphM.cutImage(), _subgraphN.cutImage());
+    return _cutImage;
+}
 
-    return mergeSolutions(fM.result(), fN.result());
+void ImageGraphDual::reserve(unsigned int width, unsigned int height)
+{
+    _subgraphM.reserve(_splitX + 1, height);
+    _subgraphN.reserve(width - _splitX, height);
 }
 
 void ImageGraphDual::setLambda(float lambda)
@@ -122,6 +158,28 @@ void ImageGraphDual::setLambda(float lambda)
     _subgraphN.setLambda(lambda);
 }
 
+bool ImageGraphDual::graphReductionEnabled() const
+{
+    return _subgraphM.graphReductionEnabled();
+}
+
+void ImageGraphDual::setGraphReductionEnabled(bool enabled)
+{
+    _subgraphM.setGraphReductionEnabled(enabled);
+    _subgraphN.setGraphReductionEnabled(enabled);
+}
+
+ImageGraphPrimal::CapacityType ImageGraphDual::capacityType() const
+{
+    return _subgraphM.capacityType();
+}
+
+void ImageGraphDual::setCapacityType(ImageGraphPrimal::CapacityType capacityType)
+{
+    _subgraphM.setCapacityType(capacityType);
+    _subgraphN.setCapacityType(capacityType);
+}
+
 void ImageGraphDual::setSigma(float sigma)
 {
     ImageGraph::setSigma(sigma);
@@ -129,24 +187,199 @@ void ImageGraphDual::setSigma(float sigma)
     _subgraphN.setSigma(sigma);
 }
 
-ImageGraph::ImageArray ImageGraphDual::mergeSolutions(
+void ImageGraphDual::addSeeds(const std::vector<Coordinate>& pixels, PixelMask::PixelType type)
+{
+    // the subgraphs share the pixel mask, they only have to update their terminal edges
+    ImageGraph::addSeeds(pixels, type);
+    _subgraphM.updateSeeds(pixels);
+    _subgraphN.updateSeeds(pixels);
+}
+
+void ImageGraphDual::mergeSolutions(
         const ImageGraph::ImageArray &solutionM,
         const ImageGraph::ImageArray &solutionN)
 {
-    ImageGraph::ImageArray result(solutionM);
+    // left of the split from M, the rest from N, written into the persistent result
+    // while keeping track of what changed since the last merge
+    unsigned int width = _imageArray.shape(0);
+    unsigned int height = _imageArray.shape(1);
 
-    try
+    beginCutUpdate();
+    for(unsigned int y = 0; y < height; y++)
     {
-        result.subarray(vigra::Shape2(_splitX, 0), _imageArray.shape()) =
-                solutionN.subarray(vigra::Shape2(_splitX, 0), _imageArray.shape());
+        for(unsigned int x = 0; x < width; x++)
+        {
+            updateCutLabel(x, y, (x < _splitX) ? solutionM(x, y) : solutionN(x, y));
+        }
     }
-    catch(std::exception e)
+    endCutUpdate();
+}
+
+unsigned int ImageGraphDual::updateLagrangiansAtSeam()
+{
+    _subgraphM.extractColumnLabels(_splitX, _seamLabelsM);
+    _subgraphN.extractColumnLabels(_splitX, _seamLabelsN);
+    return takeSubgradientStep(_seamLabelsM, _seamLabelsN);
+}
+
+unsigned int ImageGraphDual::takeSubgradientStep(const ImageGraphPrimal::LabelBits &labelsM, const ImageGraphPrimal::LabelBits &labelsN)
+{
+    // count disagreements and take the subgradient step in one pass over 64 rows at a time,
+    // only rows that disagree are touched
+    unsigned int numDisagreements = 0;
+    for(unsigned int w = 0; w < labelsM.size(); w++)
     {
-        std::cout << "Error when copying: " << e.what() << std::endl;
+        uint64_t disagreement = labelsM[w] ^ labelsN[w];
+        numDisagreements += __builtin_popcountll(disagreement);
+
+        while(disagreement)
+        {
+            unsigned int bit = __builtin_ctzll(disagreement);
+            bool nodeInSourceSetForM = (labelsM[w] >> bit) & 1;
+
+            // stick to a stepsize of 1 for now
+            _lagrangians[64 * w + bit] -= nodeInSourceSetForM ? 100.0f : -100.0f;
+
+            disagreement &= disagreement - 1;
+        }
     }
 
-    return result;
+    return numDisagreements;
+}
+
+void ImageGraphDual::publishLagrangians(AsyncChannel &channelM, AsyncChannel &channelN)
+{
+    channelM.lagrangians.writeBuffer() = _lagrangians;
+    channelM.lagrangians.publish();
+
+    std::vector<float>& negatedLagrangians = channelN.lagrangians.writeBuffer();
+    negatedLagrangians.resize(_lagrangians.size());
+    std::transform(_lagrangians.begin(), _lagrangians.end(), negatedLagrangians.begin(), [](float x){return -x;});
+    channelN.lagrangians.publish();
 }
+
+void ImageGraphDual::runAsyncWorker(ImageGraphPrimal &subgraph, AsyncChannel &channel, AsyncChannel &otherChannel,
+                                    WakeupSignal &labelsArrived, const std::atomic<bool> &stop)
+{
+    while(true)
+    {
+        unsigned int seenWakeups = channel.wakeup.count();
+        if(stop.load(std::memory_order_acquire))
+            break;
+
+        // re-solve as soon as new multipliers arrived, unless too far ahead of the other subproblem
+        unsigned int numSolves = channel.numSolves.load(std::memory_order_relaxed);
+        if(numSolves > otherChannel.numSolves.load(std::memory_order_acquire) + _maxStaleness ||
+           !channel.lagrangians.receive())
+        {
+            channel.wakeup.waitForChange(seenWakeups);
+            continue;
+        }
+
+        // only the seam changed since the last cut, which therefore starts from the last flow
+        subgraph.updateLagrangians(channel.lagrangians.readBuffer());
+        subgraph.runMinCut();
+
+        subgraph.extractColumnLabels(_splitX, channel.labels.writeBuffer());
+        channel.labels.publish();
+        channel.numSolves.store(numSolves + 1, std::memory_order_release);
+
+        // the other subproblem may be waiting for this one to catch up
+        otherChannel.wakeup.notify();
+        labelsArrived.notify();
+    }
+}
+
+unsigned int ImageGraphDual::runAsynchronous()
+{
+    AsyncChannel channelM;
+    AsyncChannel channelN;
+    WakeupSignal labelsArrived;
+    std::atomic<bool> stop(false);
+
+    publishLagrangians(channelM, channelN);
+    _workerM.start([&]() { runAsyncWorker(_subgraphM, channelM, channelN, labelsArrived, stop); });
+    _workerN.start([&]() { runAsyncWorker(_subgraphN, channelN, channelM, labelsArrived, stop); });
+
+    // Update the multipliers whenever either side delivered new seam labels, using the latest labels of the other.
+    // Both sides deliver at least once before stopping, so the result never holds labels of an earlier cut.
+    bool receivedM = false;
+    bool receivedN = false;
+    unsigned int numUpdates = 0;
+    while(true)
+    {
+        unsigned int seenArrivals = labelsArrived.count();
+        bool newLabelsM = channelM.labels.receive();
+        bool newLabelsN = channelN.labels.receive();
+        receivedM |= newLabelsM;
+        receivedN |= newLabelsN;
+
+        if(!(newLabelsM || newLabelsN) || !receivedM || !receivedN)
+        {
+            labelsArrived.waitForChange(seenArrivals);
+            continue;
+        }
+
+        if(numUpdates >= _numIterations)
+            break;
+
+        unsigned int sum = takeSubgradientStep(channelM.labels.readBuffer(), channelN.labels.readBuffer());
+        if(sum == 0)
+            break;
+
+        numUpdates++;
+        publishLagrangians(channelM, channelN);
+        channelM.wakeup.notify();
+        channelN.wakeup.notify();
+    }
+
+    stop.store(true, std::memory_order_release);
+    channelM.wakeup.notify();
+    channelN.wakeup.notify();
+    _workerM.wait();
+    _workerN.wait();
+
+    if(_loggingEnabled)
+    {
+        std::cout << "\nAsynchronous: " << numUpdates << " multiplier updates, " << channelM.numSolves << " cuts of M and "
+                  << channelN.numSolves << " cuts of N" << std::endl;
+    }
+
+    // the workers may have finished one more cut after the last check, count on their final labels
+    _subgraphM.extractColumnLabels(_splitX, _seamLabelsM);
+    _subgraphN.extractColumnLabels(_splitX, _seamLabelsN);
+    unsigned int numDisagreements = 0;
+    for(unsigned int w = 0; w < _seamLabelsM.size(); w++)
+        numDisagreements += __builtin_popcountll(_seamLabelsM[w] ^ _seamLabelsN[w]);
+
+    return numDisagreements;
+}
+
+bool ImageGraphDual::asynchronous() const
+{
+    return _asynchronous;
+}
+
+void ImageGraphDual::setAsynchronous(bool asynchronous)
+{
+    _asynchronous = asynchronous;
+}
+
+unsigned int ImageGraphDual::maxStaleness() const
+{
+    return _maxStaleness;
+}
+
+void ImageGraphDual::setMaxStaleness(unsigned int maxStaleness)
+{
+    _maxStaleness = maxStaleness;
+}
+
+unsigned int ImageGraphDual::numDisagreements() const
+{
+    return _numDisagreements;
+}
+
 unsigned int ImageGraphDual::numIterations() const
 {
     return _numIterations;
@@ -3,26 +3,73 @@
 
 #include "ImageGraph.h"
 #include "ImageGraphPrimal.h"
+#include "Mailbox.h"
+#include "Parallel.h"
+#include <atomic>
 
 class ImageGraphDual : public ImageGraph
 {
 public:
     ImageGraphDual(const std::string& imageFilename,
                    const std::string& maskFilename);
+    ImageGraphDual(const ImageArray& image,
+                   const ImageArray& mask);
     virtual ~ImageGraphDual();
 
     virtual void buildGraph();
-    virtual ImageArray runMinCut();
+    virtual const ImageArray& runMinCut();
+    virtual void reserve(unsigned int width, unsigned int height);
 
     virtual void setLambda(float lambda);
     virtual void setSigma(float sigma);
+    virtual void addSeeds(const std::vector<Coordinate>& pixels, PixelMask::PixelType type);
 
+    // upper bound on the number of multiplier updates per cut, both subproblems are cut at least once even for 0
     unsigned int numIterations() const;
     void setNumIterations(unsigned int numIterations);
 
+    // Asynchronous mode: each subproblem runs on its own thread and re-solves as soon as new
+    // multipliers are available, instead of waiting for the other one in every iteration.
+    // A subproblem is at most maxStaleness solves ahead of the other, 0 makes them alternate in lockstep.
+    bool asynchronous() const;
+    void setAsynchronous(bool asynchronous);
+    unsigned int maxStaleness() const;
+    void setMaxStaleness(unsigned int maxStaleness);
+
+    // pixels at the seam on which the subproblems disagreed after the last cut, 0 once they converged
+    unsigned int numDisagreements() const;
+
+    // see ImageGraphPrimal::setGraphReductionEnabled(), applies to both subproblems
+    bool graphReductionEnabled() const;
+    void setGraphReductionEnabled(bool enabled);
+
+    // see ImageGraphPrimal::setCapacityType(), integer capacities make the seam labels reproducible
+    ImageGraphPrimal::CapacityType capacityType() const;
+    void setCapacityType(ImageGraphPrimal::CapacityType capacityType);
+
 private:
-    ImageGraph::ImageArray mergeSolutions(const ImageArray &solutionM,
-                                          const ImageArray &solutionN);
+    void setupSubgraphs();
+    void mergeSolutions(const ImageArray &solutionM,
+                        const ImageArray &solutionN);
+    unsigned int updateLagrangiansAtSeam();
+    // subgradient step on the multipliers where the seam labels disagree, returns the number of disagreements
+    unsigned int takeSubgradientStep(const ImageGraphPrimal::LabelBits& labelsM, const ImageGraphPrimal::LabelBits& labelsN);
+
+    // messages between the coordinating thread and the thread solving one subproblem.
+    // The solving thread sleeps on wakeup until there are new multipliers or it may run ahead again.
+    struct AsyncChannel {
+        AsyncChannel(): numSolves(0) {}
+        Mailbox< std::vector<float> > lagrangians;
+        Mailbox< ImageGraphPrimal::LabelBits > labels;
+        std::atomic<unsigned int> numSolves;
+        WakeupSignal wakeup;
+    };
+
+    unsigned int runAsynchronous();
+    // labelsArrived is notified after every cut, the coordinating thread sleeps on it
+    void runAsyncWorker(ImageGraphPrimal& subgraph, AsyncChannel& channel, AsyncChannel& otherChannel,
+                        WakeupSignal& labelsArrived, const std::atomic<bool>& stop);
+    void publishLagrangians(AsyncChannel& channelM, AsyncChannel& channelN);
 
 private:
     ImageGraphPrimal _subgraphM;
@@ -30,8 +77,21 @@ private:
 
     unsigned int _splitX;
     std::vector<float> _lagrangians;
+    std::vector<float> _negatedLagrangians;
+
+    // boundary labels of both subproblems at the seam column
+    ImageGraphPrimal::LabelBits _seamLabelsM;
+    ImageGraphPrimal::LabelBits _seamLabelsN;
 
     unsigned int _numIterations;
+    bool _asynchronous;
+    unsigned int _maxStaleness;
+    unsigned int _numDisagreements;
+
+    // solves N while the calling thread solves M, started once and reused for every iteration.
+    // In asynchronous mode both subproblems are solved on these while the calling thread coordinates.
+    WorkerThread _workerN;
+    WorkerThread _workerM;
 };
 
 #endif // IMAGEGRAPHDUAL_H
@@ -0,0 +1,510 @@
+#include "ImageGraphMultiProcess.h"
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iterator>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+namespace {
+
+// full path of an executable, searched in PATH unless it contains a slash. Empty if not found.
+std::string findExecutable(const std::string& name)
+{
+    if(name.find('/') != std::string::npos)
+        return access(name.c_str(), X_OK) == 0 ? name : std::string();
+
+    const char* path = getenv("PATH");
+    std::string directories = path ? path : "/usr/local/bin:/usr/bin:/bin";
+    size_t begin = 0;
+    while(begin <= directories.size())
+    {
+        size_t end = directories.find(':', begin);
+        if(end == std::string::npos)
+            end = directories.size();
+
+        std::string directory = directories.substr(begin, end - begin);
+        std::string candidate = (directory.empty() ? std::string(".") : directory) + "/" + name;
+        if(access(candidate.c_str(), X_OK) == 0)
+            return candidate;
+
+        begin = end + 1;
+    }
+    return std::string();
+}
+
+} // namespace
+
+ImageGraphMultiProcess::ImageGraphMultiProcess(const std::string &imageFilename, const std::string &maskFilename, unsigned int numTiles):
+    ImageGraph(imageFilename, maskFilename),
+    _numIterations(1),
+    _numDisagreements(0),
+    _numRestarts(0),
+    _workerExecutable("graphcut-tileworker")
+{
+    setupTiles(numTiles);
+}
+
+ImageGraphMultiProcess::ImageGraphMultiProcess(const ImageArray &image, const ImageArray &mask, unsigned int numTiles):
+    ImageGraph(image, mask),
+    _numIterations(1),
+    _numDisagreements(0),
+    _numRestarts(0),
+    _workerExecutable("graphcut-tileworker")
+{
+    setupTiles(numTiles);
+}
+
+ImageGraphMultiProcess::~ImageGraphMultiProcess()
+{
+    for(Tile& tile : _tiles)
+    {
+        if(tile.pid <= 0)
+            continue;
+
+        _message.reset(TILE_SHUTDOWN);
+        if(_message.send(tile.fd))
+        {
+            close(tile.fd);
+            waitpid(tile.pid, NULL, 0);
+            tile.fd = -1;
+            tile.pid = 0;
+        }
+        else
+        {
+            stopWorker(tile);
+        }
+    }
+}
+
+void ImageGraphMultiProcess::setupTiles(unsigned int numTiles)
+{
+    unsigned int width = _imageArray.shape(0);
+    vigra_precondition(numTiles >= 1 && numTiles <= width,
+                       "ImageGraphMultiProcess: the number of tiles has to be between 1 and the image width");
+
+    // Same overlapping split as ImageGraphDual between each pair of neighbors: the seam column belongs
+    // to both tiles. The seams are strictly increasing as long as there are at most as many tiles as columns.
+    _seamColumns.resize(numTiles - 1);
+    for(unsigned int i = 0; i + 1 < numTiles; i++)
+        _seamColumns[i] = (unsigned int)((size_t)width * (i + 1) / numTiles);
+    _lagrangians.assign(numTiles - 1, std::vector<float>(_imageArray.shape(1), 0));
+
+    _tiles.resize(numTiles);
+    for(unsigned int i = 0; i < numTiles; i++)
+    {
+        Tile& tile = _tiles[i];
+        tile.minX = (i > 0) ? _seamColumns[i - 1] : 0;
+        tile.maxX = (i + 1 < numTiles) ? _seamColumns[i] + 1 : width;
+
+        tile.seamColumns.clear();
+        if(i > 0)
+            tile.seamColumns.push_back(0);
+        if(i + 1 < numTiles)
+            tile.seamColumns.push_back(_seamColumns[i] - tile.minX);
+    }
+
+    _cutImage.reshape(_imageArray.shape(), 0);
+}
+
+void ImageGraphMultiProcess::invalidateParameters()
+{
+    for(Tile& tile : _tiles)
+        tile.needsParameters = true;
+}
+
+size_t ImageGraphMultiProcess::maxPayloadSize(const Tile &tile) const
+{
+    return maxTilePayloadSize(tile.maxX - tile.minX, _imageArray.shape(1));
+}
+
+void ImageGraphMultiProcess::startWorker(Tile &tile)
+{
+    // everything the child needs is prepared here, after fork() it only calls async-signal-safe functions
+    std::string executable = findExecutable(_workerExecutable);
+    if(executable.empty())
+        vigra_fail("ImageGraphMultiProcess: could not find the tile worker executable " + _workerExecutable);
+
+    // close-on-exec, so neither end leaks into workers started later or other programs of the host
+    int fds[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+        vigra_fail("ImageGraphMultiProcess: could not create a socket pair for a worker");
+
+    std::string fdArgument = std::to_string(fds[1]);
+    std::string widthArgument = std::to_string(tile.maxX - tile.minX);
+    std::string heightArgument = std::to_string(_imageArray.shape(1));
+    char* argv[] = { const_cast<char*>(executable.c_str()), const_cast<char*>(fdArgument.c_str()),
+                     const_cast<char*>(widthArgument.c_str()), const_cast<char*>(heightArgument.c_str()), NULL };
+
+    pid_t pid = fork();
+    if(pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        vigra_fail("ImageGraphMultiProcess: could not fork a worker");
+    }
+
+    if(pid == 0)
+    {
+        // worker: only its own end survives the exec, the new program starts with a clean address space
+        if(fcntl(fds[1], F_SETFD, 0) == 0)
+            execve(argv[0], argv, environ);
+        _exit(127);
+    }
+
+    close(fds[1]);
+    tile.pid = pid;
+    tile.fd = fds[0];
+    tile.needsSetup = true;
+}
+
+void ImageGraphMultiProcess::stopWorker(Tile &tile)
+{
+    if(tile.fd >= 0)
+        close(tile.fd);
+    if(tile.pid > 0)
+    {
+        kill(tile.pid, SIGKILL);
+        waitpid(tile.pid, NULL, 0);
+    }
+
+    tile.fd = -1;
+    tile.pid = 0;
+}
+
+void ImageGraphMultiProcess::restartWorker(Tile &tile)
+{
+    std::cerr << "Worker for columns " << tile.minX << " to " << tile.maxX << " failed, restarting it" << std::endl;
+
+    stopWorker(tile);
+    startWorker(tile);
+    _numRestarts++;
+
+    if(!sendSetup(tile))
+        vigra_fail("ImageGraphMultiProcess: restarted worker does not respond");
+}
+
+bool ImageGraphMultiProcess::sendSetup(Tile &tile)
+{
+    unsigned int width = tile.maxX - tile.minX;
+    unsigned int height = _imageArray.shape(1);
+
+    _message.reset(TILE_SETUP);
+    _message.append<uint32_t>(width);
+    _message.append<uint32_t>(height);
+    _message.append<uint32_t>(tile.seamColumns.size());
+    _message.appendArray(tile.seamColumns.data(), tile.seamColumns.size());
+    _message.append<float>(_lambda);
+    _message.append<float>(_sigma);
+    _message.append<PixelMask::RegionModel>(_pixelMask.regionModel());
+
+    for(unsigned int y = 0; y < height; y++)
+        _message.appendArray(&_imageArray(tile.minX, y), width);
+
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = tile.minX; x < tile.maxX; x++)
+        {
+            vigra::UInt8 seed = PixelMask::NONE;
+            if(_pixelMask.pixelIsForeground(x, y))
+                seed = PixelMask::FOREGROUND;
+            else if(_pixelMask.pixelIsBackground(x, y))
+                seed = PixelMask::BACKGROUND;
+            _message.append<vigra::UInt8>(seed);
+        }
+    }
+
+    tile.needsSetup = !_message.send(tile.fd);
+    tile.needsParameters = tile.needsSetup;
+    return !tile.needsSetup;
+}
+
+bool ImageGraphMultiProcess::sendParameters(Tile &tile)
+{
+    _message.reset(TILE_PARAMETERS);
+    _message.append<float>(_lambda);
+    _message.append<float>(_sigma);
+    _message.append<PixelMask::RegionModel>(_pixelMask.regionModel());
+
+    tile.needsParameters = !_message.send(tile.fd);
+    return !tile.needsParameters;
+}
+
+bool ImageGraphMultiProcess::sendSeeds(Tile &tile, const std::vector<Coordinate> &pixels, PixelMask::PixelType type)
+{
+    unsigned int width = tile.maxX - tile.minX;
+    unsigned int height = _imageArray.shape(1);
+
+    _seedIndices.clear();
+    for(const Coordinate& c : pixels)
+    {
+        if(c.first >= tile.minX && c.first < tile.maxX && c.second < height)
+            _seedIndices.push_back(c.second * width + (c.first - tile.minX));
+    }
+
+    // The model changed even if no seed lies in this tile, so there is at least one message.
+    // Each holds at most one index per pixel, which keeps it within the payload limit.
+    size_t begin = 0;
+    do
+    {
+        size_t count = std::min<size_t>(_seedIndices.size() - begin, width * height);
+        _message.reset(TILE_SEEDS);
+        _message.append<vigra::UInt8>(type);
+        _message.append<PixelMask::RegionModel>(_pixelMask.regionModel());
+        _message.append<uint32_t>(count);
+        _message.appendArray(_seedIndices.data() + begin, count);
+        if(!_message.send(tile.fd))
+            return false;
+
+        begin += count;
+    }
+    while(begin < _seedIndices.size());
+
+    return true;
+}
+
+bool ImageGraphMultiProcess::sendLagrangians(Tile &tile)
+{
+    _message.reset(TILE_LAGRANGIANS);
+    _message.append<uint32_t>(tile.lagrangians.size());
+    _message.appendArray(tile.lagrangians.data(), tile.lagrangians.size());
+    return _message.send(tile.fd);
+}
+
+bool ImageGraphMultiProcess::receiveLabels(Tile &tile)
+{
+    if(!_message.receive(tile.fd, maxPayloadSize(tile)) || _message.type() != TILE_LABELS)
+        return false;
+
+    // one bit per row of each seam, a worker sending any other count is restarted
+    unsigned int numWords = tile.seamColumns.size() * ((_imageArray.shape(1) + 63) / 64);
+    if(_message.read<uint32_t>() != numWords)
+        return false;
+
+    tile.seamLabels.resize(numWords);
+    _message.readArray(tile.seamLabels.data(), numWords);
+    return _message.isValid();
+}
+
+bool ImageGraphMultiProcess::fetchResult(Tile &tile, unsigned int resultMinX, unsigned int resultMaxX)
+{
+    _message.reset(TILE_GET_RESULT);
+    if(!_message.send(tile.fd) || !_message.receive(tile.fd, maxPayloadSize(tile)) || _message.type() != TILE_RESULT)
+        return false;
+
+    unsigned int width = tile.maxX - tile.minX;
+    unsigned int height = _imageArray.shape(1);
+    std::vector<vigra::UInt8> row(width);
+
+    for(unsigned int y = 0; y < height; y++)
+    {
+        _message.readArray(row.data(), width);
+        for(unsigned int x = resultMinX; x < resultMaxX; x++)
+            updateCutLabel(x, y, row[x - tile.minX]);
+    }
+    return _message.isValid();
+}
+
+void ImageGraphMultiProcess::solveTiles()
+{
+    // send to all first, so the workers solve concurrently
+    std::vector<bool> sent(_tiles.size());
+    for(unsigned int i = 0; i < _tiles.size(); i++)
+    {
+        Tile& tile = _tiles[i];
+        if(tile.pid <= 0)
+            startWorker(tile);
+
+        // a new worker gets the whole tile, a running one only what changed since
+        bool isUpToDate = tile.needsSetup ? sendSetup(tile) : (!tile.needsParameters || sendParameters(tile));
+        sent[i] = isUpToDate && sendLagrangians(tile);
+    }
+
+    for(unsigned int i = 0; i < _tiles.size(); i++)
+    {
+        Tile& tile = _tiles[i];
+        if(sent[i] && receiveLabels(tile))
+            continue;
+
+        restartWorker(tile);
+        if(!sendLagrangians(tile) || !receiveLabels(tile))
+            vigra_fail("ImageGraphMultiProcess: worker failed again after a restart");
+    }
+}
+
+void ImageGraphMultiProcess::buildGraph()
+{
+    // the workers rebuild the costs of their tiles with the current parameters before the next cut
+    invalidateParameters();
+}
+
+const ImageGraph::ImageArray& ImageGraphMultiProcess::runMinCut()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    unsigned int sum = 0;
+
+    // at least one cut, a worker has no result before its first
+    unsigned int numIterations = std::max(1u, _numIterations);
+    for(unsigned int iteration = 0; iteration < numIterations; iteration++)
+    {
+        // like ImageGraphDual, the tile left of a seam gets its multipliers and the one right of it the negated ones
+        for(unsigned int i = 0; i < _tiles.size(); i++)
+        {
+            std::vector<float>& lagrangians = _tiles[i].lagrangians;
+            lagrangians.clear();
+            if(i > 0)
+                std::transform(_lagrangians[i - 1].begin(), _lagrangians[i - 1].end(), std::back_inserter(lagrangians), [](float x){return -x;});
+            if(i + 1 < _tiles.size())
+                lagrangians.insert(lagrangians.end(), _lagrangians[i].begin(), _lagrangians[i].end());
+        }
+
+        solveTiles();
+
+        sum = updateLagrangiansAtSeams();
+        if(sum == 0)
+            break;
+
+        if(_loggingEnabled)
+            std::cout << "\nIteration " << iteration << ": There were " << sum << " disagreeing pixels\n" << std::endl;
+    }
+
+    if(_loggingEnabled)
+        std::cout << "\nEnd: There were " << sum << " disagreeing pixels\n" << std::endl;
+    _numDisagreements = sum;
+
+    // each tile up to the next seam, which is taken from the tile right of it
+    beginCutUpdate();
+    for(unsigned int i = 0; i < _tiles.size(); i++)
+    {
+        Tile& tile = _tiles[i];
+        unsigned int resultMaxX = (i + 1 < _tiles.size()) ? _seamColumns[i] : tile.maxX;
+        if(fetchResult(tile, tile.minX, resultMaxX))
+            continue;
+
+        // a new worker has to cut its tile again before it can answer
+        restartWorker(tile);
+        if(!sendLagrangians(tile) || !receiveLabels(tile) || !fetchResult(tile, tile.minX, resultMaxX))
+            vigra_fail("ImageGraphMultiProcess: worker failed again after a restart");
+    }
+    endCutUpdate();
+
+    if(_loggingEnabled)
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+        std::cout << "Solving with worker processes took: " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
+    }
+
+    return _cutImage;
+}
+
+unsigned int ImageGraphMultiProcess::updateLagrangiansAtSeams()
+{
+    unsigned int numWords = (_imageArray.shape(1) + 63) / 64;
+    unsigned int numDisagreements = 0;
+
+    // same subgradient step as ImageGraphDual on every seam, between the last seam of the left tile
+    // and the first of the right one. receiveLabels() made sure both cover their seams.
+    for(unsigned int seam = 0; seam < _seamColumns.size(); seam++)
+    {
+        const ImageGraphPrimal::LabelBits& labelsLeft = _tiles[seam].seamLabels;
+        const uint64_t* labelsM = labelsLeft.data() + labelsLeft.size() - numWords;
+        const uint64_t* labelsN = _tiles[seam + 1].seamLabels.data();
+        std::vector<float>& lagrangians = _lagrangians[seam];
+
+        for(unsigned int w = 0; w < numWords; w++)
+        {
+            uint64_t disagreement = labelsM[w] ^ labelsN[w];
+            numDisagreements += __builtin_popcountll(disagreement);
+
+            while(disagreement)
+            {
+                unsigned int bit = __builtin_ctzll(disagreement);
+                bool nodeInSourceSetForM = (labelsM[w] >> bit) & 1;
+                lagrangians[64 * w + bit] -= nodeInSourceSetForM ? 100.0f : -100.0f;
+                disagreement &= disagreement - 1;
+            }
+        }
+    }
+
+    return numDisagreements;
+}
+
+void ImageGraphMultiProcess::reserve(unsigned int, unsigned int)
+{
+}
+
+void ImageGraphMultiProcess::setLambda(float lambda)
+{
+    ImageGraph::setLambda(lambda);
+    invalidateParameters();
+}
+
+void ImageGraphMultiProcess::setSigma(float sigma)
+{
+    ImageGraph::setSigma(sigma);
+    invalidateParameters();
+}
+
+void ImageGraphMultiProcess::addSeeds(const std::vector<Coordinate> &pixels, PixelMask::PixelType type)
+{
+    ImageGraph::addSeeds(pixels, type);
+
+    // running workers only get the new seeds, the others get the whole mask with their setup
+    for(Tile& tile : _tiles)
+    {
+        if(tile.pid > 0 && !tile.needsSetup && !sendSeeds(tile, pixels, type))
+            tile.needsSetup = true;
+    }
+}
+
+void ImageGraphMultiProcess::reestimateModel(const ImageArray &labels)
+{
+    ImageGraph::reestimateModel(labels);
+    invalidateParameters();
+}
+
+unsigned int ImageGraphMultiProcess::numIterations() const
+{
+    return _numIterations;
+}
+
+void ImageGraphMultiProcess::setNumIterations(unsigned int numIterations)
+{
+    _numIterations = numIterations;
+}
+
+const std::string& ImageGraphMultiProcess::workerExecutable() const
+{
+    return _workerExecutable;
+}
+
+void ImageGraphMultiProcess::setWorkerExecutable(const std::string &executable)
+{
+    _workerExecutable = executable;
+}
+
+unsigned int ImageGraphMultiProcess::numTiles() const
+{
+    return _tiles.size();
+}
+
+pid_t ImageGraphMultiProcess::workerProcessId(unsigned int tile) const
+{
+    vigra_precondition(tile < _tiles.size(), "ImageGraphMultiProcess::workerProcessId: no such tile");
+    return _tiles[tile].pid;
+}
+
+unsigned int ImageGraphMultiProcess::numDisagreements() const
+{
+    return _numDisagreements;
+}
+
+unsigned int ImageGraphMultiProcess::numWorkerRestarts() const
+{
+    return _numRestarts;
+}
@@ -0,0 +1,117 @@
+#ifndef IMAGEGRAPHMULTIPROCESS_H
+#define IMAGEGRAPHMULTIPROCESS_H
+
+#include "ImageGraph.h"
+#include "ImageGraphPrimal.h"
+#include "TileProtocol.h"
+#include <sys/types.h>
+
+/**
+ * Dual decomposition like ImageGraphDual, but the image is split into a row of overlapping tiles,
+ * each owned by a worker process that is started on demand and talks to this coordinator over a
+ * local socket. Neighboring tiles share one seam column with its own multipliers, so n tiles have
+ * n - 1 seams. Two tiles split the image like ImageGraphDual.
+ * Workers run the graphcut-tileworker executable (see TileWorker.h), not a fork of this process,
+ * so they never see the whole image: only the tile images, seam labels and multipliers are exchanged.
+ *
+ * Only the graphs are distributed. The coordinator still holds the whole image, pixel mask and
+ * label image to send the tiles and assemble the result, so its memory limits the image size.
+ *
+ * The tile is sent once per worker. Afterwards parameter changes and new seeds are sent as
+ * such, and the worker updates its graph in place like ImageGraphPrimal does.
+ * A worker that crashes or closes its socket is restarted with the current tile and the last
+ * multipliers it received, the cut continues. Workers are shut down with the graph.
+ */
+class ImageGraphMultiProcess : public ImageGraph
+{
+public:
+    // numTiles between 1 and the image width, the tiles are about equally wide
+    ImageGraphMultiProcess(const std::string& imageFilename, const std::string& maskFilename, unsigned int numTiles = 2);
+    ImageGraphMultiProcess(const ImageArray& image, const ImageArray& mask, unsigned int numTiles = 2);
+    virtual ~ImageGraphMultiProcess();
+
+    virtual void buildGraph();
+    virtual const ImageArray& runMinCut();
+    // the workers allocate their tiles themselves
+    virtual void reserve(unsigned int width, unsigned int height);
+
+    virtual void setLambda(float lambda);
+    virtual void setSigma(float sigma);
+    virtual void addSeeds(const std::vector<Coordinate>& pixels, PixelMask::PixelType type);
+    virtual void reestimateModel(const ImageArray& labels);
+
+    // upper bound on the number of multiplier updates per cut, the tiles are cut at least once even for 0
+    unsigned int numIterations() const;
+    void setNumIterations(unsigned int numIterations);
+
+    // program started for each worker, searched in PATH unless it contains a slash.
+    // Defaults to graphcut-tileworker, takes effect for workers started afterwards.
+    const std::string& workerExecutable() const;
+    void setWorkerExecutable(const std::string& executable);
+
+    // tiles are numbered from left to right
+    unsigned int numTiles() const;
+    // process id of the worker of the given tile, 0 if it is not running
+    pid_t workerProcessId(unsigned int tile) const;
+    // pixels on all seams on which neighboring tiles disagreed after the last cut, 0 once they converged
+    unsigned int numDisagreements() const;
+    // how often a worker had to be restarted so far
+    unsigned int numWorkerRestarts() const;
+
+private:
+    struct Tile {
+        Tile(): minX(0), maxX(0), pid(0), fd(-1), needsSetup(true), needsParameters(false) {}
+
+        // columns [minX, maxX) of the image, and the seams on its left and right end in tile coordinates
+        unsigned int minX;
+        unsigned int maxX;
+        std::vector<unsigned int> seamColumns;
+
+        pid_t pid;
+        int fd;
+        // a new worker gets the whole tile, a running one the parameters once they changed
+        bool needsSetup;
+        bool needsParameters;
+
+        // last multipliers sent, to repeat them after a restart, and the seam labels of the answer.
+        // Both hold all seams of the tile one after the other.
+        std::vector<float> lagrangians;
+        ImageGraphPrimal::LabelBits seamLabels;
+    };
+
+    void setupTiles(unsigned int numTiles);
+    void invalidateParameters();
+    size_t maxPayloadSize(const Tile& tile) const;
+
+    void startWorker(Tile& tile);
+    void stopWorker(Tile& tile);
+    void restartWorker(Tile& tile);
+
+    // each returns false if the worker did not answer
+    bool sendSetup(Tile& tile);
+    bool sendParameters(Tile& tile);
+    bool sendSeeds(Tile& tile, const std::vector<Coordinate>& pixels, PixelMask::PixelType type);
+    bool sendLagrangians(Tile& tile);
+    bool receiveLabels(Tile& tile);
+    bool fetchResult(Tile& tile, unsigned int resultMinX, unsigned int resultMaxX);
+
+    // solve all tiles concurrently with their current multipliers
+    void solveTiles();
+    unsigned int updateLagrangiansAtSeams();
+
+private:
+    std::vector<Tile> _tiles;
+    // image column and multipliers of the seam between tile i and i + 1
+    std::vector<unsigned int> _seamColumns;
+    std::vector< std::vector<float> > _lagrangians;
+    unsigned int _numIterations;
+    unsigned int _numDisagreements;
+    unsigned int _numRestarts;
+    std::string _workerExecutable;
+
+    // reused for all messages
+    TileMessage _message;
+    std::vector<uint32_t> _seedIndices;
+};
+
+#endif // IMAGEGRAPHMULTIPROCESS_H
@@ -1,5 +1,6 @@
 #include "ImageGraphPrimal.h"
 #include <chrono>
+#include <cstdlib>
 
 ImageGraphPrimal::ImageGraphPrimal(const std::string &imageFilename, const std::string &maskFilename):
     ImageGraph(imageFilename, maskFilename),
@@ -8,48 +9,156 @@ ImageGraphPrimal::ImageGraphPrimal(const std::string &imageFilename, const std::
     _maxX(_imageArray.shape(0)),
     _maxY(_imageArray.shape(1)),
     _preflow(NULL),
-    _loggingEnabled(true),
-    _splitX(SPLIT_NOT_SET),
-    _lagrangians(_imageArray.shape(1), 0)
+    _flow(_graph),
+    _flowIsValid(false),
+    _cutIsValid(false),
+    _reductionEnabled(false),
+    _coreCosts(_coreGraph),
+    _coreElevator(NULL),
+    _corePreflow(NULL),
+    _coreFlow(_coreGraph),
+    _coreFlowIsValid(false),
+    _capacityType(FLOAT_CAPACITIES),
+    _quantizedSolver(NULL),
+    _quantizedCoreSolver(NULL),
+    _ownCapacityScale(0.0),
+    _sharedCapacityScale(0.0),
+    _quantizedCostsAreValid(false),
+    _topologyIsBuilt(false),
+    _seamColumns(),
+    _lagrangians(_imageArray.shape(1), 0),
+    _temporalLabels(),
+    _temporalWeight(0.0f)
+{
+}
+
+ImageGraphPrimal::ImageGraphPrimal(const ImageArray &image, const ImageArray &mask):
+    ImageGraph(image, mask),
+    _minX(0),
+    _minY(0),
+    _maxX(_imageArray.shape(0)),
+    _maxY(_imageArray.shape(1)),
+    _preflow(NULL),
+    _flow(_graph),
+    _flowIsValid(false),
+    _cutIsValid(false),
+    _reductionEnabled(false),
+    _coreCosts(_coreGraph),
+    _coreElevator(NULL),
+    _corePreflow(NULL),
+    _coreFlow(_coreGraph),
+    _coreFlowIsValid(false),
+    _capacityType(FLOAT_CAPACITIES),
+    _quantizedSolver(NULL),
+    _quantizedCoreSolver(NULL),
+    _ownCapacityScale(0.0),
+    _sharedCapacityScale(0.0),
+    _quantizedCostsAreValid(false),
+    _topologyIsBuilt(false),
+    _seamColumns(),
+    _lagrangians(_imageArray.shape(1), 0),
+    _temporalLabels(),
+    _temporalWeight(0.0f)
+{
+}
+
+ImageGraphPrimal::ImageGraphPrimal(const ImageArray &image, const ImageArray &mask, const PixelMask::RegionModel &model):
+    ImageGraph(image, mask, model),
+    _minX(0),
+    _minY(0),
+    _maxX(_imageArray.shape(0)),
+    _maxY(_imageArray.shape(1)),
+    _preflow(NULL),
+    _flow(_graph),
+    _flowIsValid(false),
+    _cutIsValid(false),
+    _reductionEnabled(false),
+    _coreCosts(_coreGraph),
+    _coreElevator(NULL),
+    _corePreflow(NULL),
+    _coreFlow(_coreGraph),
+    _coreFlowIsValid(false),
+    _capacityType(FLOAT_CAPACITIES),
+    _quantizedSolver(NULL),
+    _quantizedCoreSolver(NULL),
+    _ownCapacityScale(0.0),
+    _sharedCapacityScale(0.0),
+    _quantizedCostsAreValid(false),
+    _topologyIsBuilt(false),
+    _seamColumns(),
+    _lagrangians(_imageArray.shape(1), 0),
+    _temporalLabels(),
+    _temporalWeight(0.0f)
+{
+}
+
+ImageGraphPrimal::ImageGraphPrimal(ImageGraph *parent):
+    ImageGraph(parent),
+    _minX(0),
+    _minY(0),
+    _maxX(_imageArray.shape(0)),
+    _maxY(_imageArray.shape(1)),
+    _preflow(NULL),
+    _flow(_graph),
+    _flowIsValid(false),
+    _cutIsValid(false),
+    _reductionEnabled(false),
+    _coreCosts(_coreGraph),
+    _coreElevator(NULL),
+    _corePreflow(NULL),
+    _coreFlow(_coreGraph),
+    _coreFlowIsValid(false),
+    _capacityType(FLOAT_CAPACITIES),
+    _quantizedSolver(NULL),
+    _quantizedCoreSolver(NULL),
+    _ownCapacityScale(0.0),
+    _sharedCapacityScale(0.0),
+    _quantizedCostsAreValid(false),
+    _topologyIsBuilt(false),
+    _seamColumns(),
+    _lagrangians(_imageArray.shape(1), 0),
+    _temporalLabels(),
+    _temporalWeight(0.0f)
 {
 }
 
 ImageGraphPrimal::~ImageGraphPrimal()
 {
     delete _preflow;
+    delete _corePreflow;
+    delete _coreElevator;
+    delete _quantizedSolver;
+    delete _quantizedCoreSolver;
 }
 
-void ImageGraphPrimal::createEdgeToNodeWithIndex(unsigned int x0,
-                                           unsigned int y0,
-                                           unsigned int x1,
-                                           unsigned int y1,
-                                           unsigned int width,
-                                           Graph::Node& a,
-                                           std::vector<Graph::Node>& nodes)
+float ImageGraphPrimal::boundaryPenalty(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const
 {
-    Graph::Node& b = nodes[y1 * width + x1];
-    Edge e = ADD_EDGE(a, b);
-
     // compute gradient magnitude
-    float gradientMagnitude = (float)(_imageArray(x0, y0) - _imageArray(x1, y1)); // / 255.0f;
+    float gradientMagnitude = (float)(_imageArray(_minX + x0, _minY + y0) - _imageArray(_minX + x1, _minY + y1)); // / 255.0f;
     gradientMagnitude *= gradientMagnitude;
 
     float distance = sqrtf((x0 - x1) * (x0 - x1) + (y0 - y1) * (y0 - y1));
-    float boundaryPenalty = 100.0f * expf(-gradientMagnitude / (2.0f * powf(_sigma,2.0f))) / distance;
-    _maxBoundaryPenalty = std::max(_maxBoundaryPenalty, boundaryPenalty);
+    return 100.0f * expf(-gradientMagnitude / (2.0f * powf(_sigma,2.0f))) / distance;
+}
 
-    // add lagrangian if at split border
-    if(_splitX != SPLIT_NOT_SET && x0 == _splitX)
+int ImageGraphPrimal::seamIndex(unsigned int x) const
+{
+    // at most one seam on each side
+    for(unsigned int i = 0; i < _seamColumns.size(); i++)
     {
-        boundaryPenalty *= 0.5f;
+        if(_minX + x == _seamColumns[i])
+            return i;
     }
+    return -1;
+}
 
-    _costs[e] = boundaryPenalty;
+bool ImageGraphPrimal::edgeIsInOverlap(unsigned int x0, unsigned int x1) const
+{
+    return x0 == x1 && seamIndex(x0) >= 0;
 }
 
-void ImageGraphPrimal::insertEdgeToSource(unsigned int x, unsigned int y, Graph::Node& a, vigra::UInt8 pixelValue)
+float ImageGraphPrimal::sourceCost(unsigned int x, unsigned int y, vigra::UInt8 pixelValue) const
 {
-    Edge e = ADD_EDGE(a, _sourceNode);
     float cost = 0.0f;
 
     if(_pixelMask.pixelIsForeground(_minX + x, _minY + y))
@@ -57,20 +166,26 @@ void ImageGraphPrimal::insertEdgeToSource(unsigned int x, unsigned int y, Graph:
     else if(_pixelMask.pixelIsBackground(_minX + x, _minY + y))
         cost = 0;
     else
+    {
         cost = _lambda * _pixelMask.backgroundRegionPenalty(pixelValue);
 
+        // keep pixels that were foreground before
+        if(_temporalWeight > 0.0f && _temporalLabels(_minX + x, _minY + y))
+            cost += _temporalWeight;
+    }
+
     // add lagrangian if at split border, and half cost
-    if(_splitX != SPLIT_NOT_SET && x == _splitX)
+    int seam = seamIndex(x);
+    if(seam >= 0)
     {
-        cost = 0.5f * cost + _lagrangians[y];
+        cost = 0.5f * cost + _lagrangians[seam * (_maxY - _minY) + y];
     }
 
-    _costs[e] = cost;
+    return cost;
 }
 
-void ImageGraphPrimal::insertEdgeToSink(unsigned int x, unsigned int y, Graph::Node& a, vigra::UInt8 pixelValue)
+float ImageGraphPrimal::sinkCost(unsigned int x, unsigned int y, vigra::UInt8 pixelValue) const
 {
-    Edge e = ADD_EDGE(a, _sinkNode);
     float cost = 0.0f;
 
     if(_pixelMask.pixelIsBackground(_minX + x, _minY + y))
@@ -78,74 +193,531 @@ void ImageGraphPrimal::insertEdgeToSink(unsigned int x, unsigned int y, Graph::N
     else if(_pixelMask.pixelIsForeground(_minX + x, _minY + y))
         cost = 0;
     else
+    {
         cost = _lambda * _pixelMask.foregroundRegionPenalty(pixelValue);
 
+        // keep pixels that were background before
+        if(_temporalWeight > 0.0f && !_temporalLabels(_minX + x, _minY + y))
+            cost += _temporalWeight;
+    }
+
     // add lagrangian if at split border
-    if(_splitX != SPLIT_NOT_SET && x == _splitX)
+    int seam = seamIndex(x);
+    if(seam >= 0)
+    {
+        cost = 0.5f * cost - _lagrangians[seam * (_maxY - _minY) + y];
+    }
+
+    return cost;
+}
+
+namespace {
+    // Adding the same amount to both terminal edges of a node does not change the cut,
+    // so raise both until the flow of the last solve fits into the new capacities again.
+    // Then no flow has to be withdrawn and the old flow remains a valid starting point.
+    void setTerminalCapacities(const Graph& graph, const Graph::ArcMap<float>& flow, EdgeMap& costs,
+                               Edge sourceEdge, Edge sinkEdge, float sourceCost, float sinkCost)
+    {
+        float flowFromSource = std::max(flow[graph.direct(sourceEdge, true)], flow[graph.direct(sourceEdge, false)]);
+        float flowToSink = std::max(flow[graph.direct(sinkEdge, true)], flow[graph.direct(sinkEdge, false)]);
+        float shift = std::max(0.0f, std::max(flowFromSource - sourceCost, flowToSink - sinkCost));
+
+        costs[sourceEdge] = sourceCost + shift;
+        costs[sinkEdge] = sinkCost + shift;
+    }
+}
+
+void ImageGraphPrimal::setTerminalCosts(unsigned int index, float sourceCost, float sinkCost)
+{
+    if(_flowIsValid)
+    {
+        setTerminalCapacities(_graph, _flow, _costs, _sourceEdges[index], _sinkEdges[index], sourceCost, sinkCost);
+    }
+    else
     {
-        cost = 0.5f * cost - _lagrangians[y];
+        _costs[_sourceEdges[index]] = sourceCost;
+        _costs[_sinkEdges[index]] = sinkCost;
+    }
+
+    if(_quantizedCostsAreValid)
+        _quantizedSolver->updateTerminalEdges(_sourceEdges[index], _sinkEdges[index], sourceCost, sinkCost);
+}
+
+void ImageGraphPrimal::setBoundaryCost(Edge e, float cost)
+{
+    if(_flowIsValid)
+    {
+        for(int direction = 0; direction < 2; direction++)
+        {
+            Graph::Arc arc = _graph.direct(e, direction == 0);
+            float withdrawnFlow = _flow[arc] - cost;
+            if(withdrawnFlow <= 0.0f)
+                continue;
+
+            // The flow that no longer fits stays at the tail as excess, which a preflow allows.
+            // The head gets it from the source instead, after raising both of its terminal edges
+            // by the same amount, which does not change the cut.
+            _flow[arc] = cost;
+
+            Coordinate c = _coordinates[_graph.target(arc)];
+            unsigned int index = (c.second - _minY) * (_maxX - _minX) + (c.first - _minX);
+            Edge sourceEdge = _sourceEdges[index];
+            _costs[sourceEdge] += withdrawnFlow;
+            _costs[_sinkEdges[index]] += withdrawnFlow;
+            _flow[_graph.direct(sourceEdge, _sourceNode)] += withdrawnFlow;
+        }
     }
 
     _costs[e] = cost;
+
+    if(_quantizedCostsAreValid)
+        _quantizedSolver->updateEdge(e, cost);
 }
 
-void ImageGraphPrimal::addBoundaryEdgesAndPenalties(
-        unsigned int width,
-        unsigned int height,
-        std::vector<Graph::Node>& nodes)
+void ImageGraphPrimal::buildTopology(unsigned int width, unsigned int height)
 {
     if(_loggingEnabled)
-        std::cout << "Adding Edges and their weights..." << std::endl;
+        std::cout << "Generating graph nodes and edges..." << std::endl;
+
+    delete _preflow;
+    _preflow = NULL;
+    _flowIsValid = false;
+    _cutIsValid = false;
 
+    // the core solver is sized for the pixels of the old range
+    delete _corePreflow;
+    _corePreflow = NULL;
+    delete _coreElevator;
+    _coreElevator = NULL;
+    _coreFixedLabels.clear();
+
+    delete _quantizedSolver;
+    _quantizedSolver = NULL;
+    delete _quantizedCoreSolver;
+    _quantizedCoreSolver = NULL;
+    _quantizedCostsAreValid = false;
+
+    _graph.clear();
+    reserve(width, height);
+
+    // create nodes
+    _nodes.resize(width*height);
+    std::generate(_nodes.begin(), _nodes.end(), [&]() { return _graph.addNode(); });
+
+    // fill the coordinate map
     for(unsigned int y = 0; y < height; y++)
     {
         for(unsigned int x = 0; x < width; x++)
         {
-            Graph::Node& a = nodes[y * width + x];
+            _coordinates[_nodes[y * width + x]] = std::make_pair(_minX + x, _minY + y);
+        }
+    }
 
-            // for all but the last row insert edge to the next node in y
-            if(y < height - 1)
-            {
-                createEdgeToNodeWithIndex(x, y, x, y+1, width, a, nodes);
-            }
+    // insert sink and source
+    _sinkNode = _graph.addNode();
+    _sourceNode = _graph.addNode();
 
-            // for all but the last column insert edge to the next node in x
-            if(x < width - 1)
-            {
-                createEdgeToNodeWithIndex(x, y, x+1, y, width, a, nodes);
-            }
+    // edges between neighboring pixels
+    _boundaryEdges.clear();
+    forEachNeighborPair(width, height, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+    {
+        _boundaryEdges.push_back(ADD_EDGE(_nodes[y0 * width + x0], _nodes[y1 * width + x1]));
+    });
 
-            // diagonal connection as well
-            if(x < width - 1 && y < height - 1)
-            {
-                createEdgeToNodeWithIndex(x, y, x+1, y+1, width, a, nodes);
-            }
+    // edges to source and sink
+    _sourceEdges.resize(width*height);
+    _sinkEdges.resize(width*height);
+    for(unsigned int i = 0; i < width*height; i++)
+    {
+        _sourceEdges[i] = ADD_EDGE(_nodes[i], _sourceNode);
+        _sinkEdges[i] = ADD_EDGE(_nodes[i], _sinkNode);
+    }
 
-            if(x < width - 1 && y > 1)
-            {
-                createEdgeToNodeWithIndex(x, y, x+1, y-1, width, a, nodes);
-            }
+    // the preflow allocates its buffers on the first init and keeps them for all following solves
+    _preflow = new lemon::Preflow< Graph, EdgeMap >(_graph, _costs, _sourceNode, _sinkNode);
+    _preflow->flowMap(_flow);
+
+    _cutImage.reshape(_imageArray.shape(), 0);
+    _topologyIsBuilt = true;
+}
+
+void ImageGraphPrimal::updateBoundaryPenalties(unsigned int width, unsigned int height)
+{
+    if(_loggingEnabled)
+        std::cout << "Computing edge weights..." << std::endl;
+
+    _incidentPenalties.assign(width * height, 0.0f);
+    std::vector<Edge>::const_iterator edge = _boundaryEdges.begin();
+    forEachNeighborPair(width, height, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+    {
+        float penalty = boundaryPenalty(x0, y0, x1, y1);
+        _incidentPenalties[y0 * width + x0] += penalty;
+        _incidentPenalties[y1 * width + x1] += penalty;
+
+        if(edgeIsInOverlap(x0, x1))
+        {
+            penalty *= 0.5f;
         }
-    }
+
+        _costs[*edge++] = penalty;
+    });
+
+    // a seed outweighs all edges of any pixel together, so no cut separates it from its terminal
+    for(float incidentPenalty : _incidentPenalties)
+        _maxBoundaryPenalty = std::max(_maxBoundaryPenalty, incidentPenalty);
 }
 
-void ImageGraphPrimal::addRegionEdgesAndPenalties(
-        unsigned int width,
-        unsigned int height,
-        std::vector<Graph::Node>& nodes)
+void ImageGraphPrimal::updateRegionPenalties(unsigned int width, unsigned int height)
 {
     for(unsigned int y = 0; y < height; y++)
     {
         for(unsigned int x = 0; x < width; x++)
         {
-            Graph::Node& a = nodes[y * width + x];
-            // add edges to source and sink, weighted by the pixel color
+            // weight edges to source and sink by the pixel color
             vigra::UInt8 pixelValue = _imageArray(_minX + x, _minY + y);
-            insertEdgeToSource(x, y, a, pixelValue);
-            insertEdgeToSink(x, y, a, pixelValue);
+            _costs[_sourceEdges[y * width + x]] = sourceCost(x, y, pixelValue);
+            _costs[_sinkEdges[y * width + x]] = sinkCost(x, y, pixelValue);
         }
     }
 }
+
+unsigned int ImageGraphPrimal::nodeIndex(Graph::Node n) const
+{
+    Coordinate c = _coordinates[n];
+    return (c.second - _minY) * (_maxX - _minX) + (c.first - _minX);
+}
+
+void ImageGraphPrimal::fixLabel(unsigned int index, int8_t label)
+{
+    _fixedLabels[index] = label;
+
+    // the edges to undetermined neighbors become terminal edges of those neighbors
+    for(Graph::OutArcIt arc(_graph, _nodes[index]); arc != lemon::INVALID; ++arc)
+    {
+        Graph::Node neighbor = _graph.target(arc);
+        if(neighbor == _sourceNode || neighbor == _sinkNode)
+            continue;
+
+        unsigned int neighborIndex = nodeIndex(neighbor);
+        if(_fixedLabels[neighborIndex] != 0)
+            continue;
+
+        float capacity = _costs[arc];
+        _terminalBalance[neighborIndex] += label * capacity;
+        _undeterminedCapacity[neighborIndex] -= capacity;
+        _pendingPixels.push_back(neighborIndex);
+    }
+}
+
+void ImageGraphPrimal::reduceGraph(unsigned int width, unsigned int height)
+{
+    unsigned int numPixels = width * height;
+    _fixedLabels.assign(numPixels, 0);
+    _terminalBalance.resize(numPixels);
+    _undeterminedCapacity.assign(numPixels, 0.0f);
+
+    // Pre-augmentation: min(source, sink) capacity of every pixel is pushed straight from the source
+    // to the sink. Afterwards at most one terminal edge per pixel is left, stored as the signed balance.
+    for(unsigned int i = 0; i < numPixels; i++)
+    {
+        _terminalBalance[i] = _costs[_sourceEdges[i]] - _costs[_sinkEdges[i]];
+    }
+
+    std::vector<Edge>::const_iterator edge = _boundaryEdges.begin();
+    forEachNeighborPair(width, height, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+    {
+        float capacity = _costs[*edge++];
+        _undeterminedCapacity[y0 * width + x0] += capacity;
+        _undeterminedCapacity[y1 * width + x1] += capacity;
+    });
+
+    // contract seeds into the terminals
+    _pendingPixels.clear();
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            if(_pixelMask.pixelIsForeground(_minX + x, _minY + y))
+                fixLabel(y * width + x, 1);
+            else if(_pixelMask.pixelIsBackground(_minX + x, _minY + y))
+                fixLabel(y * width + x, -1);
+        }
+    }
+
+    // Persistency: if a pixel's terminal balance outweighs all edges to undetermined neighbors,
+    // some minimal cut puts it on that side. Fixing it can decide its neighbors in turn.
+    for(unsigned int i = 0; i < numPixels; i++)
+        _pendingPixels.push_back(i);
+
+    while(!_pendingPixels.empty())
+    {
+        unsigned int index = _pendingPixels.back();
+        _pendingPixels.pop_back();
+        if(_fixedLabels[index] != 0)
+            continue;
+
+        if(_terminalBalance[index] >= _undeterminedCapacity[index])
+            fixLabel(index, 1);
+        else if(-_terminalBalance[index] >= _undeterminedCapacity[index])
+            fixLabel(index, -1);
+    }
+}
+
+void ImageGraphPrimal::buildCoreTopology(unsigned int width, unsigned int height)
+{
+    unsigned int numPixels = width * height;
+
+    // clear() keeps the storage of the graph and its maps, so a core of similar size needs no allocation
+    _coreGraph.clear();
+    _coreSinkNode = _coreGraph.addNode();
+    _coreSourceNode = _coreGraph.addNode();
+
+    _coreNodes.assign(numPixels, lemon::INVALID);
+    _coreSourceEdges.assign(numPixels, lemon::INVALID);
+    _coreSinkEdges.assign(numPixels, lemon::INVALID);
+    for(unsigned int i = 0; i < numPixels; i++)
+    {
+        if(_fixedLabels[i] != 0)
+            continue;
+
+        _coreNodes[i] = _coreGraph.addNode();
+        _coreSourceEdges[i] = _coreGraph.addEdge(_coreNodes[i], _coreSourceNode);
+        _coreSinkEdges[i] = _coreGraph.addEdge(_coreNodes[i], _coreSinkNode);
+    }
+
+    _coreBoundaryEdges.clear();
+    forEachNeighborPair(width, height, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+    {
+        Graph::Node u = _coreNodes[y0 * width + x0];
+        Graph::Node v = _coreNodes[y1 * width + x1];
+        _coreBoundaryEdges.push_back(u != lemon::INVALID && v != lemon::INVALID ? _coreGraph.addEdge(u, v) : Edge(lemon::INVALID));
+    });
+
+    if(!_corePreflow)
+    {
+        // the core never has more nodes than the full graph, so one elevator fits every core of this range
+        _coreElevator = new lemon::Preflow< Graph, EdgeMap >::Elevator(_coreGraph, numPixels + 2);
+        _corePreflow = new lemon::Preflow< Graph, EdgeMap >(_coreGraph, _coreCosts, _coreSourceNode, _coreSinkNode);
+        _corePreflow->elevator(*_coreElevator);
+        _corePreflow->flowMap(_coreFlow);
+    }
+    else
+    {
+        _corePreflow->source(_coreSourceNode);
+        _corePreflow->target(_coreSinkNode);
+    }
+
+    if(_quantizedCoreSolver)
+        _quantizedCoreSolver->updateTopology(_coreSourceNode, _coreSinkNode);
+
+    _coreFixedLabels = _fixedLabels;
+    _coreFlowIsValid = false;
+}
+
+void ImageGraphPrimal::updateCoreCosts(unsigned int width, unsigned int height)
+{
+    // after pre-augmentation at most one terminal edge of a core pixel has capacity
+    for(unsigned int i = 0; i < width * height; i++)
+    {
+        if(_fixedLabels[i] != 0)
+            continue;
+
+        float sourceCost = std::max(0.0f, _terminalBalance[i]);
+        float sinkCost = std::max(0.0f, -_terminalBalance[i]);
+        if(_coreFlowIsValid)
+        {
+            setTerminalCapacities(_coreGraph, _coreFlow, _coreCosts, _coreSourceEdges[i], _coreSinkEdges[i], sourceCost, sinkCost);
+        }
+        else
+        {
+            _coreCosts[_coreSourceEdges[i]] = sourceCost;
+            _coreCosts[_coreSinkEdges[i]] = sinkCost;
+        }
+    }
+
+    for(unsigned int k = 0; k < _boundaryEdges.size(); k++)
+    {
+        Edge e = _coreBoundaryEdges[k];
+        if(e == lemon::INVALID)
+            continue;
+
+        // a neighbor edge that no longer carries its flow makes the next cut start from scratch
+        float cost = _costs[_boundaryEdges[k]];
+        if(_coreFlowIsValid && std::max(_coreFlow[_coreGraph.direct(e, true)], _coreFlow[_coreGraph.direct(e, false)]) > cost)
+            _coreFlowIsValid = false;
+
+        _coreCosts[e] = cost;
+    }
+}
+
+void ImageGraphPrimal::runReducedMinCut(unsigned int width, unsigned int height)
+{
+    reduceGraph(width, height);
+
+    bool coreChanged = _coreFixedLabels != _fixedLabels;
+    if(coreChanged)
+        buildCoreTopology(width, height);
+    updateCoreCosts(width, height);
+
+    if(_loggingEnabled)
+    {
+        unsigned int numCoreNodes = std::count(_fixedLabels.begin(), _fixedLabels.end(), 0);
+        std::cout << "Reduced graph to " << numCoreNodes << " of " << width * height << " pixels (" <<
+                     100.0f * (float)numCoreNodes / (width * height) << "%)" <<
+                     (coreChanged ? ", rebuilt the core" : ", reused the core") << std::endl;
+    }
+
+    bool quantized = _capacityType != FLOAT_CAPACITIES;
+    if(quantized)
+    {
+        _coreFlowIsValid = false;
+        runQuantizedCoreMinCut(width, height, coreChanged);
+    }
+    else
+    {
+        // same warm start as the full graph
+        if(_coreFlowIsValid)
+        {
+            if(!_corePreflow->init(_coreFlow))
+                _corePreflow->init();
+        }
+        else
+        {
+            _corePreflow->init();
+        }
+        _corePreflow->startFirstPhase();
+        _coreFlowIsValid = true;
+    }
+
+    beginCutUpdate();
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            unsigned int index = y * width + x;
+            bool inSourceSet;
+            if(_fixedLabels[index] != 0)
+                inSourceSet = _fixedLabels[index] > 0;
+            else
+                inSourceSet = quantized ? _quantizedCoreSolver->minCut(_coreNodes[index]) : _corePreflow->minCut(_coreNodes[index]);
+            updateCutLabel(_minX + x, _minY + y, inSourceSet ? 255 : 0);
+        }
+    }
+    endCutUpdate();
+}
+
+QuantizedMinCut<Graph, EdgeMap>* ImageGraphPrimal::createQuantizedSolver(const Graph &graph, Graph::Node source, Graph::Node sink, int maxNodes) const
+{
+    if(_capacityType == INT16_CAPACITIES)
+        return new QuantizedMinCutSolver<Graph, EdgeMap, int16_t, int32_t>(graph, source, sink, maxNodes);
+    else
+        return new QuantizedMinCutSolver<Graph, EdgeMap, int32_t, int64_t>(graph, source, sink, maxNodes);
+}
+
+void ImageGraphPrimal::runQuantizedMinCut()
+{
+    // all costs are quantized after a new build or scale, afterwards only the edges the setters touch
+    double scale = capacityScale();
+    if(_quantizedCostsAreValid && !_quantizedSolver->flowFits())
+    {
+        // the setters raised terminal capacities beyond the room left for the flow, the
+        // current costs give a smaller scale
+        _ownCapacityScale = 0.0;
+        scale = capacityScale();
+        _quantizedCostsAreValid = false;
+    }
+
+    if(!_quantizedCostsAreValid || _quantizedSolver->scale() != scale)
+    {
+        if(_loggingEnabled)
+            std::cout << "Quantized capacities with scale " << scale << std::endl;
+
+        _quantizedSolver->quantize(_costs, scale);
+        _quantizedCostsAreValid = true;
+    }
+
+    _quantizedSolver->run();
+}
+
+void ImageGraphPrimal::runQuantizedCoreMinCut(unsigned int width, unsigned int height, bool coreChanged)
+{
+    if(!_quantizedCoreSolver)
+    {
+        _quantizedCoreSolver = createQuantizedSolver(_coreGraph, _coreSourceNode, _coreSinkNode, width * height + 2);
+        coreChanged = true;
+    }
+
+    // the core has its own scale, as its terminal capacities include the edges to fixed pixels
+    double scale = _quantizedCoreSolver->maxScale(_coreCosts);
+    if(_sharedCapacityScale > 0.0)
+        scale = std::min(scale, _sharedCapacityScale);
+
+    if(coreChanged || _quantizedCoreSolver->scale() != scale || !_quantizedCoreSolver->flowFits())
+    {
+        if(_loggingEnabled)
+            std::cout << "Quantized core capacities with scale " << scale << std::endl;
+
+        _quantizedCoreSolver->quantize(_coreCosts, scale);
+    }
+    else
+    {
+        // same core and scale, keep the flow of the last cut where it still fits
+        for(unsigned int i = 0; i < width * height; i++)
+        {
+            if(_fixedLabels[i] == 0)
+            {
+                _quantizedCoreSolver->updateTerminalEdges(_coreSourceEdges[i], _coreSinkEdges[i],
+                                                          _coreCosts[_coreSourceEdges[i]], _coreCosts[_coreSinkEdges[i]]);
+            }
+        }
+
+        for(Edge e : _coreBoundaryEdges)
+        {
+            if(e != lemon::INVALID)
+                _quantizedCoreSolver->updateEdge(e, _coreCosts[e]);
+        }
+    }
+
+    _quantizedCoreSolver->run();
+}
+
+void ImageGraphPrimal::reserve(unsigned int width, unsigned int height)
+{
+    // per pixel: up to four edges to neighbors and two terminal edges
+    _graph.reserveNode(width * height + 2);
+    _graph.reserveEdge(6 * width * height);
+    _nodes.reserve(width * height);
+    _boundaryEdges.reserve(4 * width * height);
+    _sourceEdges.reserve(width * height);
+    _sinkEdges.reserve(width * height);
+}
+
+void ImageGraphPrimal::addSeeds(const std::vector<Coordinate>& pixels, PixelMask::PixelType type)
+{
+    ImageGraph::addSeeds(pixels, type);
+    updateSeeds(pixels);
+}
+
+void ImageGraphPrimal::updateSeeds(const std::vector<Coordinate> &pixels)
+{
+    // nothing built yet, the seeds will be picked up by buildGraph()
+    if(!_topologyIsBuilt)
+        return;
+
+    // only the terminal edges of the touched pixels change
+    unsigned int width = _maxX - _minX;
+    for(const Coordinate& c : pixels)
+    {
+        if(c.first < _minX || c.first >= _maxX || c.second < _minY || c.second >= _maxY)
+            continue;
+
+        unsigned int x = c.first - _minX;
+        unsigned int y = c.second - _minY;
+        vigra::UInt8 pixelValue = _imageArray(c.first, c.second);
+        setTerminalCosts(y * width + x, sourceCost(x, y, pixelValue), sinkCost(x, y, pixelValue));
+    }
+}
+
 float ImageGraphPrimal::sigma() const
 {
     return _sigma;
@@ -162,25 +734,39 @@ void ImageGraphPrimal::setRange(unsigned int minX, unsigned int minY, unsigned i
     _minY = minY;
     _maxX = maxX;
     _maxY = maxY;
+    _topologyIsBuilt = false;
 }
 
-void ImageGraphPrimal::setLoggingEnabled(bool enableLog)
+bool ImageGraphPrimal::isNodeInSourceSubset(unsigned int globalX, unsigned int globalY)
 {
-    _loggingEnabled = enableLog;
+    if(!_cutIsValid)
+    {
+        std::cerr << "No MinCut has been computed yet!" << std::endl;
+        return false;
+    }
+
+    // the result image holds the labels of both the full and the reduced solve
+    return _cutImage(globalX, globalY) != 0;
 }
 
-bool ImageGraphPrimal::isNodeInSourceSubset(unsigned int globalX, unsigned int globalY)
+void ImageGraphPrimal::extractColumnLabels(unsigned int globalX, LabelBits& labels) const
 {
-    if(!_preflow)
+    unsigned int height = _maxY - _minY;
+
+    // reuses the capacity of labels, so no allocation once it has the right size
+    labels.assign((height + 63) / 64, 0);
+
+    if(!_cutIsValid)
     {
         std::cerr << "No MinCut has been computed yet!" << std::endl;
-        return false;
+        return;
     }
 
-    // find appropriate node and return its state
-    unsigned int width = _maxX - _minX;
-    Graph::Node& n = _nodes[(globalY - _minY) * width + (globalX - _minX)];
-    return _preflow->minCut(n);
+    for(unsigned int y = 0; y < height; y++)
+    {
+        if(_cutImage(globalX, _minY + y))
+            labels[y >> 6] |= uint64_t(1) << (y & 63);
+    }
 }
 
 float ImageGraphPrimal::lambda() const
@@ -200,49 +786,35 @@ void ImageGraphPrimal::buildGraph()
     unsigned int width = _maxX - _minX;
     unsigned int height = _maxY - _minY;
 
-    _graph.clear();
-    _maxBoundaryPenalty = 0.0f;
+    if(!_topologyIsBuilt)
+        buildTopology(width, height);
 
-    // create nodes
     if(_loggingEnabled)
-        std::cout << "Generating graph nodes with lambda=" << _lambda << " and sigma=" << _sigma << "..." << std::endl;
+        std::cout << "Updating graph with lambda=" << _lambda << " and sigma=" << _sigma << "..." << std::endl;
 
-    _nodes = std::vector<Graph::Node>(width*height);
-    std::generate(_nodes.begin(), _nodes.end(), [&]() { return _graph.addNode(); });
-
-    // fill the coordinate map
-    if(_loggingEnabled)
-        std::cout << "Filling coordinate map..." << std::endl;
-    for(unsigned int y = 0; y < height; y++)
-    {
-        for(unsigned int x = 0; x < width; x++)
-        {
-            _coordinates[_nodes[y * width + x]] = std::make_pair(_minX + x, _minY + y);
-        }
-    }
-
-    // insert sink and source
-    _sinkNode = _graph.addNode();
-    _sourceNode = _graph.addNode();
+    // all capacities change, the next cut starts from scratch
+    _flowIsValid = false;
+    _quantizedCostsAreValid = false;
+    _ownCapacityScale = 0.0;
+    _maxBoundaryPenalty = 0.0f;
 
-    // add edges and their weights
-    addBoundaryEdgesAndPenalties(width, height, _nodes);
+    updateBoundaryPenalties(width, height);
 
     _maxBoundaryPenalty += 1.0f;
 
-    addRegionEdgesAndPenalties(width, height, _nodes);
-
-    // Some DEBUG information
-    float minCost = MAXFLOAT;
-    float maxCost = 0;
-    for(Graph::EdgeIt e(_graph); e != lemon::INVALID; ++e)
-    {
-        minCost = std::min(minCost, _costs[e]);
-        maxCost = std::max(maxCost, _costs[e]);
-    }
+    updateRegionPenalties(width, height);
 
     if(_loggingEnabled)
     {
+        // Some DEBUG information
+        float minCost = MAXFLOAT;
+        float maxCost = 0;
+        for(Graph::EdgeIt e(_graph); e != lemon::INVALID; ++e)
+        {
+            minCost = std::min(minCost, _costs[e]);
+            maxCost = std::max(maxCost, _costs[e]);
+        }
+
         std::cout << "MinCost: " << minCost <<
                      "\nmaxCost: " << maxCost <<
                      "\nmaxBoundaryPenalty: " << _maxBoundaryPenalty <<
@@ -255,7 +827,7 @@ void ImageGraphPrimal::buildGraph()
     }
 }
 
-ImageGraph::ImageArray ImageGraphPrimal::runMinCut()
+const ImageGraph::ImageArray& ImageGraphPrimal::runMinCut()
 {
     // perform min-cut / max-flow
     auto start = std::chrono::high_resolution_clock::now();
@@ -263,51 +835,293 @@ ImageGraph::ImageArray ImageGraphPrimal::runMinCut()
     if(_loggingEnabled)
         std::cout << "Running Min-Cut..." << std::endl;
 
-    // TODO: does reusing the preflow work?
-    delete _preflow;
-    _preflow = new lemon::Preflow< Graph, EdgeMap >(_graph, _costs, _sourceNode, _sinkNode);
-    _preflow->init();
-    _preflow->runMinCut();
+    unsigned int width = _maxX - _minX;
+    unsigned int height = _maxY - _minY;
+
+    if(_reductionEnabled)
+    {
+        runReducedMinCut(width, height);
+        _cutIsValid = true;
+
+        if(_loggingEnabled)
+        {
+            auto end = std::chrono::high_resolution_clock::now();
+            auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+            std::cout << "== Elapsed time: " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
+        }
+        return _cutImage;
+    }
+
+    bool quantized = _capacityType != FLOAT_CAPACITIES;
+    if(quantized)
+    {
+        // the integer solver keeps its own flow, the float flow of earlier cuts is dropped
+        _flowIsValid = false;
+        runQuantizedMinCut();
+    }
+    else
+    {
+        if(_flowIsValid)
+        {
+            // only some capacities changed since the last cut, continue from its flow.
+            // Falls back to a cold start if rounding made the old flow invalid.
+            if(!_preflow->init(_flow))
+                _preflow->init();
+        }
+        else
+        {
+            _preflow->init();
+        }
+        _preflow->startFirstPhase();
+        _flowIsValid = true;
+    }
 
     // extract nodes on the cut
     if(_loggingEnabled)
         std::cout << "Extracting results..." << std::endl;
 
-    // create vigra image of the cut
-    ImageArray cutImage(_imageArray.shape());
-    cutImage = 0;
-
+    // write the cut into the persistent result image, pixels outside the range stay 0
     unsigned int numNodesOnCut = 0;
 
-    for (Graph::NodeIt n(_graph); n != lemon::INVALID; ++n)
+    beginCutUpdate();
+    for(unsigned int y = 0; y < height; y++)
     {
-        if(_preflow->minCut(n))
+        for(unsigned int x = 0; x < width; x++)
         {
-            Coordinate c = _coordinates[n];
-            cutImage(c.first, c.second) = 255;
-            numNodesOnCut++;
+            Graph::Node n = _nodes[y * width + x];
+            bool inSourceSet = quantized ? _quantizedSolver->minCut(n) : _preflow->minCut(n);
+            updateCutLabel(_minX + x, _minY + y, inSourceSet ? 255 : 0);
+            numNodesOnCut += inSourceSet;
         }
     }
+    endCutUpdate();
+    _cutIsValid = true;
 
     if(_loggingEnabled)
     {
         std::cout << "#### Nodes on the cut: " << numNodesOnCut << " (" <<
-                     100.0f*(float)numNodesOnCut / ((_maxX - _minX) * (_maxY - _minY)) << "%)" << std::endl;
+                     100.0f*(float)numNodesOnCut / (width * height) << "%)" << std::endl;
 
         auto end = std::chrono::high_resolution_clock::now();
         auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
         std::cout << "== Elapsed time: " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
         std::cout << "@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@\n" << std::endl;
     }
-    return cutImage;
+    return _cutImage;
+}
+
+void ImageGraphPrimal::setFrame(const ImageArray &frame, unsigned int changeThreshold)
+{
+    vigra_precondition(frame.shape() == _imageArray.shape(), "ImageGraphPrimal::setFrame: frame must have the size of the image");
+
+    // the region models stay those of the first frame
+    if(!_topologyIsBuilt)
+    {
+        _imageArray = frame;
+        return;
+    }
+
+    unsigned int width = _maxX - _minX;
+    unsigned int height = _maxY - _minY;
+    _changedPixels.clear();
+
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            vigra::UInt8& pixel = _imageArray(_minX + x, _minY + y);
+            vigra::UInt8 value = frame(_minX + x, _minY + y);
+            if((unsigned int)std::abs(pixel - value) > changeThreshold)
+            {
+                pixel = value;
+                _changedPixels.push_back(y * width + x);
+            }
+        }
+    }
+
+    if(_loggingEnabled)
+        std::cout << "New frame changes " << _changedPixels.size() << " pixels" << std::endl;
+
+    // edges to neighbors first, as repairing their flow may raise terminal capacities
+    float maxIncidentPenalty = 0.0f;
+    for(unsigned int index : _changedPixels)
+    {
+        unsigned int x0 = index % width;
+        unsigned int y0 = index / width;
+
+        for(Graph::OutArcIt arc(_graph, _nodes[index]); arc != lemon::INVALID; ++arc)
+        {
+            Graph::Node neighbor = _graph.target(arc);
+            if(neighbor == _sourceNode || neighbor == _sinkNode)
+                continue;
+
+            unsigned int x1 = _coordinates[neighbor].first - _minX;
+            unsigned int y1 = _coordinates[neighbor].second - _minY;
+            unsigned int neighborIndex = y1 * width + x1;
+
+            // an edge between two changed pixels is visited twice, the second time it does not change
+            float penalty = boundaryPenalty(x0, y0, x1, y1);
+            float oldPenalty = edgeIsInOverlap(x0, x1) ? 2.0f * _costs[arc] : _costs[arc];
+            _incidentPenalties[index] += penalty - oldPenalty;
+            _incidentPenalties[neighborIndex] += penalty - oldPenalty;
+            maxIncidentPenalty = std::max(maxIncidentPenalty, std::max(_incidentPenalties[index], _incidentPenalties[neighborIndex]));
+
+            if(edgeIsInOverlap(x0, x1))
+                penalty *= 0.5f;
+
+            setBoundaryCost(arc, penalty);
+        }
+    }
+
+    // seeds have to outweigh the edges of every pixel, like after buildGraph()
+    if(maxIncidentPenalty + 1.0f > _maxBoundaryPenalty)
+    {
+        _maxBoundaryPenalty = maxIncidentPenalty + 1.0f;
+
+        for(unsigned int y = 0; y < height; y++)
+        {
+            for(unsigned int x = 0; x < width; x++)
+            {
+                if(!_pixelMask.pixelIsForeground(_minX + x, _minY + y) && !_pixelMask.pixelIsBackground(_minX + x, _minY + y))
+                    continue;
+
+                vigra::UInt8 pixelValue = _imageArray(_minX + x, _minY + y);
+                setTerminalCosts(y * width + x, sourceCost(x, y, pixelValue), sinkCost(x, y, pixelValue));
+            }
+        }
+    }
+
+    for(unsigned int index : _changedPixels)
+    {
+        unsigned int x = index % width;
+        unsigned int y = index / width;
+        vigra::UInt8 pixelValue = _imageArray(_minX + x, _minY + y);
+        setTerminalCosts(index, sourceCost(x, y, pixelValue), sinkCost(x, y, pixelValue));
+    }
+}
+
+void ImageGraphPrimal::setTemporalPrior(const ImageArray &labels, float weight)
+{
+    vigra_precondition(labels.shape() == _imageArray.shape(), "ImageGraphPrimal::setTemporalPrior: labels must have the size of the image");
+
+    // a new weight touches every pixel, otherwise only those whose label changed
+    bool updateAll = (weight != _temporalWeight) || (_temporalLabels.shape() != labels.shape());
+    if(_temporalLabels.shape() != labels.shape())
+        _temporalLabels.reshape(labels.shape(), 0);
+    _temporalWeight = weight;
+
+    unsigned int width = _maxX - _minX;
+    unsigned int height = _maxY - _minY;
+
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            vigra::UInt8& label = _temporalLabels(_minX + x, _minY + y);
+            vigra::UInt8 newLabel = labels(_minX + x, _minY + y);
+            if(!updateAll && label == newLabel)
+                continue;
+
+            label = newLabel;
+            if(_topologyIsBuilt)
+            {
+                vigra::UInt8 pixelValue = _imageArray(_minX + x, _minY + y);
+                setTerminalCosts(y * width + x, sourceCost(x, y, pixelValue), sinkCost(x, y, pixelValue));
+            }
+        }
+    }
+}
+
+bool ImageGraphPrimal::graphReductionEnabled() const
+{
+    return _reductionEnabled;
+}
+
+void ImageGraphPrimal::setGraphReductionEnabled(bool enabled)
+{
+    // capacity updates are not repaired while reduced, so a later full solve has to start cold
+    _reductionEnabled = enabled;
+    _flowIsValid = false;
+}
+
+ImageGraphPrimal::CapacityType ImageGraphPrimal::capacityType() const
+{
+    return _capacityType;
+}
+
+void ImageGraphPrimal::setCapacityType(CapacityType capacityType)
+{
+    if(capacityType == _capacityType)
+        return;
+
+    _capacityType = capacityType;
+
+    // the solvers are typed, new ones are created for the next cut
+    delete _quantizedSolver;
+    _quantizedSolver = NULL;
+    delete _quantizedCoreSolver;
+    _quantizedCoreSolver = NULL;
+    _quantizedCostsAreValid = false;
+    _ownCapacityScale = 0.0;
+}
+
+double ImageGraphPrimal::capacityScale()
+{
+    if(_capacityType == FLOAT_CAPACITIES || !_topologyIsBuilt)
+        return 0.0;
+
+    if(!_quantizedSolver)
+        _quantizedSolver = createQuantizedSolver(_graph, _sourceNode, _sinkNode, _nodes.size() + 2);
+
+    if(_ownCapacityScale == 0.0)
+        _ownCapacityScale = _quantizedSolver->maxScale(_costs);
+
+    return _sharedCapacityScale > 0.0 ? std::min(_ownCapacityScale, _sharedCapacityScale) : _ownCapacityScale;
+}
+
+void ImageGraphPrimal::setCapacityScale(double scale)
+{
+    _sharedCapacityScale = scale;
 }
 
 void ImageGraphPrimal::setSplitX(unsigned int splitX)
 {
-    _splitX = splitX;
+    _seamColumns.assign(splitX == SPLIT_NOT_SET ? 0 : 1, splitX);
+}
+
+void ImageGraphPrimal::setSeamColumns(const std::vector<unsigned int>& globalColumns)
+{
+    _seamColumns = globalColumns;
 }
 
 void ImageGraphPrimal::setLagrangians(const std::vector<float>& lagrangians)
 {
     _lagrangians = lagrangians;
 }
+
+void ImageGraphPrimal::updateLagrangians(const std::vector<float>& lagrangians)
+{
+    if(!_topologyIsBuilt || _seamColumns.empty())
+    {
+        _lagrangians = lagrangians;
+        return;
+    }
+
+    unsigned int width = _maxX - _minX;
+    unsigned int height = _maxY - _minY;
+
+    for(unsigned int seam = 0; seam < _seamColumns.size(); seam++)
+    {
+        unsigned int x = _seamColumns[seam] - _minX;
+        for(unsigned int y = 0; y < height; y++)
+        {
+            unsigned int i = seam * height + y;
+            if(lagrangians[i] == _lagrangians[i])
+                continue;
+
+            _lagrangians[i] = lagrangians[i];
+            vigra::UInt8 pixelValue = _imageArray(_seamColumns[seam], _minY + y);
+            setTerminalCosts(y * width + x, sourceCost(x, y, pixelValue), sinkCost(x, y, pixelValue));
+        }
+    }
+}
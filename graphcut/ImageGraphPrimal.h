@@ -2,14 +2,31 @@
 #define IMAGEGRAPHPRIMAL_H
 
 #include "ImageGraph.h"
+#include "QuantizedPreflow.h"
 
 class ImageGraphPrimal : public ImageGraph {
+public:
+    // one bit per row, bit i of word w belongs to row 64 * w + i
+    typedef std::vector<uint64_t> LabelBits;
+
+    // value type of the capacities the max-flow runs on
+    typedef enum {
+        FLOAT_CAPACITIES,
+        INT32_CAPACITIES,
+        INT16_CAPACITIES
+    } CapacityType;
+
 public:
     ImageGraphPrimal(const std::string& imageFilename, const std::string& maskFilename);
+    ImageGraphPrimal(const ImageArray& image, const ImageArray& mask);
+    ImageGraphPrimal(const ImageArray& image, const ImageArray& mask, const PixelMask::RegionModel& model);
+    // subproblem sharing the image and pixel mask of parent, see ImageGraph
+    explicit ImageGraphPrimal(ImageGraph* parent);
     virtual ~ImageGraphPrimal();
 
     virtual void buildGraph();
-    virtual ImageArray runMinCut();
+    virtual const ImageArray& runMinCut();
+    virtual void reserve(unsigned int width, unsigned int height);
 
     virtual float lambda() const;
     virtual void setLambda(float lambda);
@@ -17,27 +34,88 @@ public:
     virtual float sigma() const;
     virtual void setSigma(float sigma);
 
+    virtual void addSeeds(const std::vector<Coordinate>& pixels, PixelMask::PixelType type);
+
     // methods for working as a subproblem to Dual
     void setRange(unsigned int minX, unsigned int minY, unsigned int maxX, unsigned int maxY);
-    void setLoggingEnabled(bool enableLog);
+    // after the parent changed the seeds of these pixels, update their terminal edges like addSeeds()
+    void updateSeeds(const std::vector<Coordinate>& pixels);
     bool isNodeInSourceSubset(unsigned int globalX, unsigned int globalY);
+    void extractColumnLabels(unsigned int globalX, LabelBits& labels) const;
+    // Columns shared with neighboring subproblems, in increasing order. setSplitX() sets a single one,
+    // SPLIT_NOT_SET none. The multipliers of all seams are concatenated in the same order, one per row each.
     void setSplitX(unsigned int splitX);
+    void setSeamColumns(const std::vector<unsigned int>& globalColumns);
     void setLagrangians(const std::vector<float>& lagrangians);
+    // like setLagrangians() on a built graph, but only rewrites the seam terminal edges whose
+    // multiplier changed, keeping the last flow valid so the next cut is warm started
+    void updateLagrangians(const std::vector<float>& lagrangians);
+
+    // methods for segmenting sequences, both keep the last flow valid so the next cut is warm started.
+    // Replace the image by the next frame, only pixels differing by more than changeThreshold are updated.
+    void setFrame(const ImageArray& frame, unsigned int changeThreshold = 0);
+    // soft prior towards the given labels (e.g. the cut of the previous frame), weight 0 disables it
+    void setTemporalPrior(const ImageArray& labels, float weight);
+
+    // Solve only the undetermined core of the graph: seeds are contracted into the terminals,
+    // terminal capacities are pre-augmented and pixels whose label follows from a persistency
+    // test are fixed before the max-flow. Seeds outweigh all edges of a pixel, so they are hard
+    // constraints of the full graph as well and the reduced cut equals the full one.
+    // The core graph and its solver are kept as long as the same pixels are fixed, then the
+    // next cut continues from the flow of the last one.
+    bool graphReductionEnabled() const;
+    void setGraphReductionEnabled(bool enabled);
+
+    // With integer capacities the costs are scaled to the integer range and rounded. The cut only
+    // depends on the rounded capacities, so it is reproducible across builds and thread counts, and
+    // capacities take less memory. Incremental updates re-quantize only the edges they touch.
+    CapacityType capacityType() const;
+    void setCapacityType(CapacityType capacityType);
+    // Scale from costs to integer capacities, the largest at which the costs of the last buildGraph()
+    // fit unless setCapacityScale() lowered it, e.g. to quantize several graphs alike. 0 for float capacities.
+    double capacityScale();
+    // upper bound on the scale, 0 removes it
+    void setCapacityScale(double scale);
+
+    // calls f(x0, y0, x1, y1) for all pairs of neighboring pixels, in the order their edges are created
+    template<typename F>
+    static void forEachNeighborPair(unsigned int width, unsigned int height, F f);
+    // same for the pairs whose first pixel lies in the rows [beginY, endY)
+    template<typename F>
+    static void forEachNeighborPair(unsigned int width, unsigned int height, unsigned int beginY, unsigned int endY, F f);
 
 private:
-    inline void createEdgeToNodeWithIndex(unsigned int x0,
-                                          unsigned int y0,
-                                          unsigned int x1,
-                                          unsigned int y1,
-                                          unsigned int width,
-                                          Graph::Node& a,
-                                          std::vector<Graph::Node>& nodes);
+    inline float boundaryPenalty(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const;
+    // index of the seam in column x of the range, -1 if there is none
+    inline int seamIndex(unsigned int x) const;
+    // edges inside a seam column are shared by both subproblems
+    inline bool edgeIsInOverlap(unsigned int x0, unsigned int x1) const;
+    inline float sourceCost(unsigned int x, unsigned int y, vigra::UInt8 pixelValue) const;
+    inline float sinkCost(unsigned int x, unsigned int y, vigra::UInt8 pixelValue) const;
+
+    // change the terminal capacities of a built graph such that the last flow stays a valid preflow
+    void setTerminalCosts(unsigned int index, float sourceCost, float sinkCost);
+    // same for an edge between two pixels
+    void setBoundaryCost(Edge e, float cost);
+
+    // nodes and edges only depend on the range, so they are created once and reused by every buildGraph()
+    void buildTopology(unsigned int width, unsigned int height);
+    void updateBoundaryPenalties(unsigned int width, unsigned int height);
+    void updateRegionPenalties(unsigned int width, unsigned int height);
 
-    inline void insertEdgeToSink(unsigned int x, unsigned int y, Graph::Node &a, vigra::UInt8 pixelValue);
-    inline void insertEdgeToSource(unsigned int x, unsigned int y, Graph::Node &a, vigra::UInt8 pixelValue);
+    // graph reduction, fixes labels in _fixedLabels and builds the core graph of the remaining pixels
+    inline unsigned int nodeIndex(Graph::Node n) const;
+    void fixLabel(unsigned int index, int8_t label);
+    void reduceGraph(unsigned int width, unsigned int height);
+    // nodes and edges of the core only depend on the fixed pixels, capacities on the current costs
+    void buildCoreTopology(unsigned int width, unsigned int height);
+    void updateCoreCosts(unsigned int width, unsigned int height);
+    void runReducedMinCut(unsigned int width, unsigned int height);
 
-    void addBoundaryEdgesAndPenalties(unsigned int width, unsigned int height, std::vector<Graph::Node> &nodes);
-    void addRegionEdgesAndPenalties(unsigned int width, unsigned int height, std::vector<Graph::Node> &nodes);
+    // integer solver of the current capacity type, for the full graph or the core
+    QuantizedMinCut<Graph, EdgeMap>* createQuantizedSolver(const Graph& graph, Graph::Node source, Graph::Node sink, int maxNodes) const;
+    void runQuantizedMinCut();
+    void runQuantizedCoreMinCut(unsigned int width, unsigned int height, bool coreChanged);
 
 private:
     unsigned int _minX;
@@ -45,13 +123,101 @@ private:
     unsigned int _maxX;
     unsigned int _maxY;
 
-    unsigned int _splitX;
+    std::vector<unsigned int> _seamColumns;
     std::vector<float> _lagrangians;
 
+    ImageArray _temporalLabels;
+    float _temporalWeight;
+    // pixels changed by the last setFrame(), kept to reuse the storage
+    std::vector<unsigned int> _changedPixels;
+    // per pixel the sum of the boundary penalties of its edges, the cost of a seed exceeds all of them
+    std::vector<float> _incidentPenalties;
+
+    // solver workspace, lives as long as the topology
     lemon::Preflow< Graph, EdgeMap > *_preflow;
+    Graph::ArcMap<float> _flow;
+    bool _flowIsValid;
+    bool _cutIsValid;
+
+    // graph reduction workspace: per pixel the fixed label (+1 source, -1 sink, 0 undetermined),
+    // source minus sink capacity after pre-augmentation and the capacity to undetermined neighbors
+    bool _reductionEnabled;
+    std::vector<int8_t> _fixedLabels;
+    std::vector<float> _terminalBalance;
+    std::vector<float> _undeterminedCapacity;
+    std::vector<unsigned int> _pendingPixels;
+
+    // core graph of the undetermined pixels and its solver, rebuilt only if other pixels are fixed.
+    // Every core pixel has both terminal edges and an edge to every undetermined neighbor, even
+    // if their capacity is 0, so the nodes and edges do not depend on the costs.
+    std::vector<int8_t> _coreFixedLabels;
+    Graph _coreGraph;
+    EdgeMap _coreCosts;
+    std::vector<Graph::Node> _coreNodes;
+    std::vector<Edge> _coreBoundaryEdges;   // parallel to _boundaryEdges, INVALID if not in the core
+    std::vector<Edge> _coreSourceEdges;
+    std::vector<Edge> _coreSinkEdges;
+    Graph::Node _coreSourceNode;
+    Graph::Node _coreSinkNode;
+    // sized for all pixels, so the solver can stay when the core grows
+    lemon::Preflow< Graph, EdgeMap >::Elevator *_coreElevator;
+    lemon::Preflow< Graph, EdgeMap > *_corePreflow;
+    Graph::ArcMap<float> _coreFlow;
+    bool _coreFlowIsValid;
+
+    // integer solvers live as long as the topology and capacity type, like _preflow
+    CapacityType _capacityType;
+    QuantizedMinCut<Graph, EdgeMap> *_quantizedSolver;
+    QuantizedMinCut<Graph, EdgeMap> *_quantizedCoreSolver;
+    double _ownCapacityScale;       // for the costs of the last buildGraph(), 0 until computed
+    double _sharedCapacityScale;    // set by setCapacityScale()
+    bool _quantizedCostsAreValid;   // _quantizedSolver holds all current costs
+
+    bool _topologyIsBuilt;
     std::vector<Graph::Node> _nodes;
-    bool _loggingEnabled;
+    std::vector<Edge> _boundaryEdges;
+    std::vector<Edge> _sourceEdges;
+    std::vector<Edge> _sinkEdges;
 };
 
 
+template<typename F>
+void ImageGraphPrimal::forEachNeighborPair(unsigned int width, unsigned int height, F f)
+{
+    forEachNeighborPair(width, height, 0, height, f);
+}
+
+template<typename F>
+void ImageGraphPrimal::forEachNeighborPair(unsigned int width, unsigned int height, unsigned int beginY, unsigned int endY, F f)
+{
+    for(unsigned int y = beginY; y < endY; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            // for all but the last row insert edge to the next node in y
+            if(y < height - 1)
+            {
+                f(x, y, x, y+1);
+            }
+
+            // for all but the last column insert edge to the next node in x
+            if(x < width - 1)
+            {
+                f(x, y, x+1, y);
+            }
+
+            // diagonal connection as well
+            if(x < width - 1 && y < height - 1)
+            {
+                f(x, y, x+1, y+1);
+            }
+
+            if(x < width - 1 && y > 1)
+            {
+                f(x, y, x+1, y-1);
+            }
+        }
+    }
+}
+
 #endif // IMAGEGRAPHPRIMAL_H
@@ -0,0 +1,84 @@
+#include "ImageGraphSequence.h"
+#include <chrono>
+
+ImageGraphSequence::ImageGraphSequence(const ImageArray &firstFrame, const ImageArray &mask):
+    _imageGraph(firstFrame, mask),
+    _temporalWeight(1.0f),
+    _changeThreshold(0),
+    _numProcessedFrames(0),
+    _needsRebuild(true),
+    _loggingEnabled(true)
+{
+    _imageGraph.setLoggingEnabled(false);
+}
+
+void ImageGraphSequence::setLambda(float lambda)
+{
+    _imageGraph.setLambda(lambda);
+    _needsRebuild = true;
+}
+
+void ImageGraphSequence::setSigma(float sigma)
+{
+    _imageGraph.setSigma(sigma);
+    _needsRebuild = true;
+}
+
+float ImageGraphSequence::temporalWeight() const
+{
+    return _temporalWeight;
+}
+
+void ImageGraphSequence::setTemporalWeight(float temporalWeight)
+{
+    _temporalWeight = temporalWeight;
+}
+
+unsigned int ImageGraphSequence::changeThreshold() const
+{
+    return _changeThreshold;
+}
+
+void ImageGraphSequence::setChangeThreshold(unsigned int changeThreshold)
+{
+    _changeThreshold = changeThreshold;
+}
+
+const ImageGraphSequence::ImageArray& ImageGraphSequence::processFrame(const ImageArray &frame)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // the previous cut becomes the prior of this frame
+    if(_numProcessedFrames > 0)
+        _imageGraph.setTemporalPrior(_imageGraph.cutImage(), _temporalWeight);
+
+    _imageGraph.setFrame(frame, _changeThreshold);
+
+    if(_needsRebuild)
+    {
+        _imageGraph.buildGraph();
+        _needsRebuild = false;
+    }
+
+    const ImageArray& result = _imageGraph.runMinCut();
+    _numProcessedFrames++;
+
+    if(_loggingEnabled)
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+        std::cout << "Frame " << _numProcessedFrames << " took: " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
+    }
+
+    return result;
+}
+
+unsigned int ImageGraphSequence::numProcessedFrames() const
+{
+    return _numProcessedFrames;
+}
+
+void ImageGraphSequence::setLoggingEnabled(bool enableLog)
+{
+    _loggingEnabled = enableLog;
+}
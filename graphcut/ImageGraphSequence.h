@@ -0,0 +1,51 @@
+#ifndef IMAGEGRAPHSEQUENCE_H
+#define IMAGEGRAPHSEQUENCE_H
+
+#include "ImageGraphPrimal.h"
+
+/**
+ * Segments a stream of frames of the same size, e.g. a microscopy time-lapse.
+ *
+ * Graph and flow are kept alive between frames: only the capacities of pixels that
+ * changed are updated, the previous cut enters as soft temporal prior, and the
+ * max-flow continues from the previous flow instead of starting from scratch.
+ * The region models are estimated once from the constructor's image and mask.
+ */
+class ImageGraphSequence
+{
+public:
+    typedef ImageGraph::ImageArray ImageArray;
+
+public:
+    ImageGraphSequence(const ImageArray& firstFrame, const ImageArray& mask);
+
+    // rebuilds the graph before the next frame
+    void setLambda(float lambda);
+    void setSigma(float sigma);
+
+    float temporalWeight() const;
+    void setTemporalWeight(float temporalWeight);
+
+    // intensity changes up to this value are ignored, to skip sensor noise
+    unsigned int changeThreshold() const;
+    void setChangeThreshold(unsigned int changeThreshold);
+
+    // segment the next frame, the result is overwritten by the following call
+    const ImageArray& processFrame(const ImageArray& frame);
+
+    unsigned int numProcessedFrames() const;
+
+    // timing of each frame on std::cout, on by default like ImageGraph::setLoggingEnabled()
+    void setLoggingEnabled(bool enableLog);
+
+private:
+    ImageGraphPrimal _imageGraph;
+
+    float _temporalWeight;
+    unsigned int _changeThreshold;
+    unsigned int _numProcessedFrames;
+    bool _needsRebuild;
+    bool _loggingEnabled;
+};
+
+#endif // IMAGEGRAPHSEQUENCE_H
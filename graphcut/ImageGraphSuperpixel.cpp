@@ -0,0 +1,531 @@
+#include "ImageGraphSuperpixel.h"
+#include "ImageGraphPrimal.h"
+#include "Parallel.h"
+#include <vigra/slic.hxx>
+#include <chrono>
+
+ImageGraphSuperpixel::ImageGraphSuperpixel(const std::string &imageFilename, const std::string &maskFilename):
+    ImageGraph(imageFilename, maskFilename),
+    _superpixelSize(16),
+    _intensityScaling(20.0f),
+    _refinementBandWidth(0),
+    _numSuperpixels(0),
+    _superpixelsAreValid(false),
+    _preflow(NULL),
+    _bandCosts(_bandGraph),
+    _bandSourceCosts(_bandGraph),
+    _bandSinkCosts(_bandGraph),
+    _bandElevator(NULL),
+    _bandPreflow(NULL)
+{
+    _cutImage.reshape(_imageArray.shape(), 0);
+}
+
+ImageGraphSuperpixel::ImageGraphSuperpixel(const ImageArray &image, const ImageArray &mask):
+    ImageGraph(image, mask),
+    _superpixelSize(16),
+    _intensityScaling(20.0f),
+    _refinementBandWidth(0),
+    _numSuperpixels(0),
+    _superpixelsAreValid(false),
+    _preflow(NULL),
+    _bandCosts(_bandGraph),
+    _bandSourceCosts(_bandGraph),
+    _bandSinkCosts(_bandGraph),
+    _bandElevator(NULL),
+    _bandPreflow(NULL)
+{
+    _cutImage.reshape(_imageArray.shape(), 0);
+}
+
+ImageGraphSuperpixel::~ImageGraphSuperpixel()
+{
+    delete _preflow;
+    delete _bandPreflow;
+    delete _bandElevator;
+}
+
+float ImageGraphSuperpixel::boundaryPenalty(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const
+{
+    float gradientMagnitude = (float)(_imageArray(x0, y0) - _imageArray(x1, y1));
+    gradientMagnitude *= gradientMagnitude;
+
+    float distance = sqrtf((float)((x0 - x1) * (x0 - x1) + (y0 - y1) * (y0 - y1)));
+    return 100.0f * expf(-gradientMagnitude / (2.0f * powf(_sigma,2.0f))) / distance;
+}
+
+float ImageGraphSuperpixel::sourceCost(unsigned int x, unsigned int y) const
+{
+    if(_pixelMask.pixelIsForeground(x, y))
+        return _maxBoundaryPenalty;
+    else if(_pixelMask.pixelIsBackground(x, y))
+        return 0.0f;
+    else
+        return _lambda * _pixelMask.backgroundRegionPenalty(_imageArray(x, y));
+}
+
+float ImageGraphSuperpixel::sinkCost(unsigned int x, unsigned int y) const
+{
+    if(_pixelMask.pixelIsBackground(x, y))
+        return _maxBoundaryPenalty;
+    else if(_pixelMask.pixelIsForeground(x, y))
+        return 0.0f;
+    else
+        return _lambda * _pixelMask.foregroundRegionPenalty(_imageArray(x, y));
+}
+
+vigra::UInt8 ImageGraphSuperpixel::seededLabel(unsigned int x, unsigned int y, vigra::UInt8 label) const
+{
+    if(_pixelMask.pixelIsForeground(x, y))
+        return 255;
+    else if(_pixelMask.pixelIsBackground(x, y))
+        return 0;
+    else
+        return label;
+}
+
+void ImageGraphSuperpixel::computeSuperpixels()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    unsigned int width = _imageArray.shape(0);
+    unsigned int height = _imageArray.shape(1);
+
+    vigra::MultiArray<2, float> image(_imageArray);
+    _superpixels.reshape(_imageArray.shape(), 0);
+
+    // horizontal strips of whole superpixel rows are oversegmented independently in parallel
+    unsigned int numSuperpixelRows = (height + _superpixelSize - 1) / _superpixelSize;
+    unsigned int numChunks = std::min(numWorkerThreads(), numSuperpixelRows);
+    std::vector<unsigned int> numLabels(numChunks, 0);
+
+    parallelForChunks(0, numSuperpixelRows, numChunks, [&](unsigned int chunk, unsigned int beginRow, unsigned int endRow)
+    {
+        vigra::Shape2 begin(0, beginRow * _superpixelSize);
+        vigra::Shape2 end(width, std::min(height, endRow * _superpixelSize));
+        numLabels[chunk] = vigra::slicSuperpixels(image.subarray(begin, end),
+                                                  _superpixels.subarray(begin, end),
+                                                  _intensityScaling,
+                                                  _superpixelSize);
+    });
+
+    // SLIC labels start at 1 in every strip, make them unique and start at 0
+    std::vector<unsigned int> offsets(numChunks, 0);
+    for(unsigned int chunk = 1; chunk < numChunks; chunk++)
+        offsets[chunk] = offsets[chunk - 1] + numLabels[chunk - 1];
+    _numSuperpixels = offsets[numChunks - 1] + numLabels[numChunks - 1];
+
+    parallelForChunks(0, numSuperpixelRows, numChunks, [&](unsigned int chunk, unsigned int beginRow, unsigned int endRow)
+    {
+        for(unsigned int y = beginRow * _superpixelSize; y < std::min(height, endRow * _superpixelSize); y++)
+        {
+            for(unsigned int x = 0; x < width; x++)
+            {
+                _superpixels(x, y) += offsets[chunk] - 1;
+            }
+        }
+    });
+
+    _superpixelsAreValid = true;
+
+    if(_loggingEnabled)
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+        std::cout << "Computed " << _numSuperpixels << " superpixels in " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
+    }
+}
+
+void ImageGraphSuperpixel::accumulateTerms()
+{
+    unsigned int width = _imageArray.shape(0);
+    unsigned int height = _imageArray.shape(1);
+    unsigned int numChunks = std::min(numWorkerThreads(), height);
+
+    // Seeded pixels are only counted here, how they constrain their superpixel
+    // depends on its borders, which are known only after the sweep.
+    struct ChunkTerms {
+        std::vector<RegionTerms> regionTerms;
+        std::vector<unsigned int> numForegroundSeeds;
+        std::vector<unsigned int> numBackgroundSeeds;
+        BorderList borders;
+        float maxBoundaryPenalty;
+    };
+    std::vector<ChunkTerms> chunkTerms(numChunks);
+
+    parallelForChunks(0, height, numChunks, [&](unsigned int chunk, unsigned int beginY, unsigned int endY)
+    {
+        ChunkTerms& terms = chunkTerms[chunk];
+        terms.regionTerms.assign(_numSuperpixels, RegionTerms());
+        terms.numForegroundSeeds.assign(_numSuperpixels, 0);
+        terms.numBackgroundSeeds.assign(_numSuperpixels, 0);
+        terms.maxBoundaryPenalty = 0.0f;
+
+        for(unsigned int y = beginY; y < endY; y++)
+        {
+            for(unsigned int x = 0; x < width; x++)
+            {
+                vigra::UInt32 region = _superpixels(x, y);
+
+                if(_pixelMask.pixelIsForeground(x, y))
+                    terms.numForegroundSeeds[region]++;
+                else if(_pixelMask.pixelIsBackground(x, y))
+                    terms.numBackgroundSeeds[region]++;
+                else
+                {
+                    terms.regionTerms[region].sourceCost += sourceCost(x, y);
+                    terms.regionTerms[region].sinkCost += sinkCost(x, y);
+                }
+            }
+        }
+
+        // the pixel neighborhood of ImageGraphPrimal, so this is its energy summed up per superpixel.
+        // Pairs across a border are collected and merged once per chunk.
+        ImageGraphPrimal::forEachNeighborPair(width, height, beginY, endY, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+        {
+            float penalty = boundaryPenalty(x0, y0, x1, y1);
+            terms.maxBoundaryPenalty = std::max(terms.maxBoundaryPenalty, penalty);
+
+            vigra::UInt32 region = _superpixels(x0, y0);
+            vigra::UInt32 neighborRegion = _superpixels(x1, y1);
+            if(region != neighborRegion)
+            {
+                Border border = { std::min(region, neighborRegion), std::max(region, neighborRegion), penalty };
+                terms.borders.push_back(border);
+            }
+        });
+        mergeBorders(terms.borders);
+    });
+
+    _maxBoundaryPenalty = 0.0f;
+    for(const ChunkTerms& terms : chunkTerms)
+        _maxBoundaryPenalty = std::max(_maxBoundaryPenalty, terms.maxBoundaryPenalty);
+    _maxBoundaryPenalty += 1.0f;
+
+    _regionTerms.assign(_numSuperpixels, RegionTerms());
+    std::vector<unsigned int> numForegroundSeeds(_numSuperpixels, 0);
+    std::vector<unsigned int> numBackgroundSeeds(_numSuperpixels, 0);
+    _borders.clear();
+    for(const ChunkTerms& terms : chunkTerms)
+    {
+        for(unsigned int region = 0; region < _numSuperpixels; region++)
+        {
+            _regionTerms[region].sourceCost += terms.regionTerms[region].sourceCost;
+            _regionTerms[region].sinkCost += terms.regionTerms[region].sinkCost;
+            numForegroundSeeds[region] += terms.numForegroundSeeds[region];
+            numBackgroundSeeds[region] += terms.numBackgroundSeeds[region];
+        }
+
+        _borders.insert(_borders.end(), terms.borders.begin(), terms.borders.end());
+    }
+    mergeBorders(_borders);
+
+    std::vector<float> borderCapacity(_numSuperpixels, 0.0f);
+    for(const Border& border : _borders)
+    {
+        borderCapacity[border.regionA] += border.weight;
+        borderCapacity[border.regionB] += border.weight;
+    }
+
+    // A superpixel with seeds of one class only gets a terminal edge that outweighs all its other
+    // edges together, so no cut separates it from that terminal. Seeds of both classes are soft terms.
+    for(unsigned int region = 0; region < _numSuperpixels; region++)
+    {
+        RegionTerms& terms = _regionTerms[region];
+        if(numForegroundSeeds[region] > 0 && numBackgroundSeeds[region] == 0)
+        {
+            terms.sourceCost = borderCapacity[region] + terms.sinkCost + _maxBoundaryPenalty;
+        }
+        else if(numBackgroundSeeds[region] > 0 && numForegroundSeeds[region] == 0)
+        {
+            terms.sinkCost = borderCapacity[region] + terms.sourceCost + _maxBoundaryPenalty;
+        }
+        else
+        {
+            terms.sourceCost += numForegroundSeeds[region] * _maxBoundaryPenalty;
+            terms.sinkCost += numBackgroundSeeds[region] * _maxBoundaryPenalty;
+        }
+    }
+}
+
+void ImageGraphSuperpixel::mergeBorders(BorderList &borders)
+{
+    std::sort(borders.begin(), borders.end(), [](const Border& a, const Border& b)
+    {
+        return a.regionA < b.regionA || (a.regionA == b.regionA && a.regionB < b.regionB);
+    });
+
+    // in place, each border is added to the last merged one if it has the same regions
+    BorderList::iterator merged = borders.begin();
+    for(BorderList::const_iterator border = borders.begin(); border != borders.end(); ++border)
+    {
+        if(merged != borders.begin() && (merged - 1)->regionA == border->regionA && (merged - 1)->regionB == border->regionB)
+            (merged - 1)->weight += border->weight;
+        else
+            *merged++ = *border;
+    }
+    borders.erase(merged, borders.end());
+}
+
+void ImageGraphSuperpixel::buildGraph()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if(!_superpixelsAreValid)
+        computeSuperpixels();
+
+    accumulateTerms();
+
+    // the region adjacency graph is small, so it is simply rebuilt
+    delete _preflow;
+    _preflow = NULL;
+    _graph.clear();
+    reserve(_imageArray.shape(0), _imageArray.shape(1));
+
+    _nodes.resize(_numSuperpixels);
+    std::generate(_nodes.begin(), _nodes.end(), [&]() { return _graph.addNode(); });
+    _sinkNode = _graph.addNode();
+    _sourceNode = _graph.addNode();
+
+    for(unsigned int region = 0; region < _numSuperpixels; region++)
+    {
+        _costs[ADD_EDGE(_nodes[region], _sourceNode)] = _regionTerms[region].sourceCost;
+        _costs[ADD_EDGE(_nodes[region], _sinkNode)] = _regionTerms[region].sinkCost;
+    }
+
+    for(const Border& border : _borders)
+        _costs[ADD_EDGE(_nodes[border.regionA], _nodes[border.regionB])] = border.weight;
+
+    if(_loggingEnabled)
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+        std::cout << "Region graph with " << _numSuperpixels << " nodes and " << _borders.size()
+                  << " borders took: " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
+    }
+}
+
+const ImageGraph::ImageArray& ImageGraphSuperpixel::runMinCut()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if(!_preflow)
+        _preflow = new lemon::Preflow< Graph, EdgeMap >(_graph, _costs, _sourceNode, _sinkNode);
+    _preflow->runMinCut();
+
+    std::vector<vigra::UInt8> regionLabels(_numSuperpixels);
+    for(unsigned int region = 0; region < _numSuperpixels; region++)
+        regionLabels[region] = _preflow->minCut(_nodes[region]) ? 255 : 0;
+
+    beginCutUpdate();
+    for(unsigned int y = 0; y < _imageArray.shape(1); y++)
+    {
+        for(unsigned int x = 0; x < _imageArray.shape(0); x++)
+        {
+            updateCutLabel(x, y, seededLabel(x, y, regionLabels[_superpixels(x, y)]));
+        }
+    }
+
+    if(_refinementBandWidth > 0)
+        refineBand();
+    endCutUpdate();
+
+    if(_loggingEnabled)
+    {
+        auto end = std::chrono::high_resolution_clock::now();
+        auto elapsed_milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count();
+        std::cout << "Superpixel Min-Cut took: " << 0.001f * elapsed_milliseconds << " secs" << std::endl;
+    }
+
+    return _cutImage;
+}
+
+void ImageGraphSuperpixel::refineBand()
+{
+    int width = _imageArray.shape(0);
+    int height = _imageArray.shape(1);
+
+    // chessboard distance to the closest pixel at a label border, by a forward and a backward
+    // raster scan over the 8-neighborhood
+    if(_bandDistance.shape() != _imageArray.shape())
+        _bandDistance.reshape(_imageArray.shape());
+    vigra::MultiArray<2, int>& distance = _bandDistance;
+    distance.init(width + height);
+    ImageGraphPrimal::forEachNeighborPair(width, height, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+    {
+        if(_cutImage(x0, y0) != _cutImage(x1, y1))
+            distance(x0, y0) = 0;
+    });
+
+    for(int y = 0; y < height; y++)
+    {
+        for(int x = 0; x < width; x++)
+        {
+            int& d = distance(x, y);
+            if(x > 0)
+                d = std::min(d, distance(x - 1, y) + 1);
+            if(y > 0)
+            {
+                d = std::min(d, distance(x, y - 1) + 1);
+                if(x > 0)
+                    d = std::min(d, distance(x - 1, y - 1) + 1);
+                if(x + 1 < width)
+                    d = std::min(d, distance(x + 1, y - 1) + 1);
+            }
+        }
+    }
+    for(int y = height - 1; y >= 0; y--)
+    {
+        for(int x = width - 1; x >= 0; x--)
+        {
+            int& d = distance(x, y);
+            if(x + 1 < width)
+                d = std::min(d, distance(x + 1, y) + 1);
+            if(y + 1 < height)
+            {
+                d = std::min(d, distance(x, y + 1) + 1);
+                if(x + 1 < width)
+                    d = std::min(d, distance(x + 1, y + 1) + 1);
+                if(x > 0)
+                    d = std::min(d, distance(x - 1, y + 1) + 1);
+            }
+        }
+    }
+
+    // pixel graph on the band, pixels outside keep the label of their superpixel.
+    // clear() keeps the storage of the graph and its maps.
+    _bandGraph.clear();
+    _bandNodes.assign(width * height, lemon::INVALID);
+    _bandSinkNode = _bandGraph.addNode();
+    _bandSourceNode = _bandGraph.addNode();
+
+    unsigned int numBandPixels = 0;
+    for(int y = 0; y < height; y++)
+    {
+        for(int x = 0; x < width; x++)
+        {
+            if(distance(x, y) <= (int)_refinementBandWidth)
+            {
+                Graph::Node node = _bandGraph.addNode();
+                _bandNodes[y * width + x] = node;
+                _bandSourceCosts[node] = sourceCost(x, y);
+                _bandSinkCosts[node] = sinkCost(x, y);
+                numBandPixels++;
+            }
+        }
+    }
+
+    // same neighborhood as ImageGraphPrimal, fixed neighbors pull towards their label
+    ImageGraphPrimal::forEachNeighborPair(width, height, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+    {
+        Graph::Node node0 = _bandNodes[y0 * width + x0];
+        Graph::Node node1 = _bandNodes[y1 * width + x1];
+        if(node0 == lemon::INVALID && node1 == lemon::INVALID)
+            return;
+
+        float penalty = boundaryPenalty(x0, y0, x1, y1);
+        if(node0 != lemon::INVALID && node1 != lemon::INVALID)
+        {
+            _bandCosts[_bandGraph.addEdge(node0, node1)] = penalty;
+            return;
+        }
+
+        Graph::Node node = (node0 != lemon::INVALID) ? node0 : node1;
+        bool neighborIsForeground = (node0 != lemon::INVALID) ? _cutImage(x1, y1) : _cutImage(x0, y0);
+        if(neighborIsForeground)
+            _bandSourceCosts[node] += penalty;
+        else
+            _bandSinkCosts[node] += penalty;
+    });
+
+    for(Graph::Node node : _bandNodes)
+    {
+        if(node == lemon::INVALID)
+            continue;
+
+        _bandCosts[_bandGraph.addEdge(node, _bandSourceNode)] = _bandSourceCosts[node];
+        _bandCosts[_bandGraph.addEdge(node, _bandSinkNode)] = _bandSinkCosts[node];
+    }
+
+    if(!_bandPreflow)
+    {
+        _bandElevator = new lemon::Preflow< Graph, EdgeMap >::Elevator(_bandGraph, width * height + 2);
+        _bandPreflow = new lemon::Preflow< Graph, EdgeMap >(_bandGraph, _bandCosts, _bandSourceNode, _bandSinkNode);
+        _bandPreflow->elevator(*_bandElevator);
+    }
+    else
+    {
+        _bandPreflow->source(_bandSourceNode);
+        _bandPreflow->target(_bandSinkNode);
+    }
+    _bandPreflow->runMinCut();
+
+    for(int y = 0; y < height; y++)
+    {
+        for(int x = 0; x < width; x++)
+        {
+            Graph::Node node = _bandNodes[y * width + x];
+            if(node != lemon::INVALID)
+                updateCutLabel(x, y, seededLabel(x, y, _bandPreflow->minCut(node) ? 255 : 0));
+        }
+    }
+
+    if(_loggingEnabled)
+        std::cout << "Refined " << numBandPixels << " pixels around superpixel borders" << std::endl;
+}
+
+void ImageGraphSuperpixel::reserve(unsigned int width, unsigned int height)
+{
+    // one node per superpixel, two terminal edges and about four borders each
+    unsigned int numSuperpixels = std::max(_numSuperpixels, width * height / (_superpixelSize * _superpixelSize));
+    _graph.reserveNode(numSuperpixels + 2);
+    _graph.reserveEdge(6 * numSuperpixels);
+}
+
+void ImageGraphSuperpixel::addSeeds(const std::vector<Coordinate> &pixels, PixelMask::PixelType type)
+{
+    // the oversegmentation stays, only the region terms change
+    ImageGraph::addSeeds(pixels, type);
+    buildGraph();
+}
+
+unsigned int ImageGraphSuperpixel::superpixelSize() const
+{
+    return _superpixelSize;
+}
+
+void ImageGraphSuperpixel::setSuperpixelSize(unsigned int superpixelSize)
+{
+    _superpixelSize = std::max(1u, superpixelSize);
+    _superpixelsAreValid = false;
+}
+
+float ImageGraphSuperpixel::intensityScaling() const
+{
+    return _intensityScaling;
+}
+
+void ImageGraphSuperpixel::setIntensityScaling(float intensityScaling)
+{
+    _intensityScaling = intensityScaling;
+    _superpixelsAreValid = false;
+}
+
+unsigned int ImageGraphSuperpixel::refinementBandWidth() const
+{
+    return _refinementBandWidth;
+}
+
+void ImageGraphSuperpixel::setRefinementBandWidth(unsigned int refinementBandWidth)
+{
+    _refinementBandWidth = refinementBandWidth;
+}
+
+const ImageGraphSuperpixel::LabelArray& ImageGraphSuperpixel::superpixels() const
+{
+    return _superpixels;
+}
+
+unsigned int ImageGraphSuperpixel::numSuperpixels() const
+{
+    return _numSuperpixels;
+}
@@ -0,0 +1,103 @@
+#ifndef IMAGEGRAPHSUPERPIXEL_H
+#define IMAGEGRAPHSUPERPIXEL_H
+
+#include "ImageGraph.h"
+
+/**
+ * Approximate graph cut on a region adjacency graph of SLIC superpixels.
+ *
+ * Every superpixel becomes one node. Its terminal edges carry the summed region terms
+ * of its pixels, edges between adjacent superpixels the summed boundary penalties of
+ * ImageGraphPrimal's pixel neighborhood along their common border. A superpixel with seeds
+ * of one class only is a hard constraint, and seeded pixels always keep their label.
+ * Optionally a pixel level cut refines a band around the borders between foreground and
+ * background superpixels.
+ */
+class ImageGraphSuperpixel : public ImageGraph
+{
+public:
+    typedef vigra::MultiArray<2, vigra::UInt32> LabelArray;
+
+public:
+    ImageGraphSuperpixel(const std::string& imageFilename, const std::string& maskFilename);
+    ImageGraphSuperpixel(const ImageArray& image, const ImageArray& mask);
+    virtual ~ImageGraphSuperpixel();
+
+    virtual void buildGraph();
+    virtual const ImageArray& runMinCut();
+    virtual void reserve(unsigned int width, unsigned int height);
+
+    virtual void addSeeds(const std::vector<Coordinate>& pixels, PixelMask::PixelType type);
+
+    // approximate edge length of a superpixel, changing it recomputes the oversegmentation
+    unsigned int superpixelSize() const;
+    void setSuperpixelSize(unsigned int superpixelSize);
+
+    // trade-off between intensity similarity and compactness of SLIC
+    float intensityScaling() const;
+    void setIntensityScaling(float intensityScaling);
+
+    // pixels closer than this to a foreground/background border are cut again per pixel, 0 disables that
+    unsigned int refinementBandWidth() const;
+    void setRefinementBandWidth(unsigned int refinementBandWidth);
+
+    const LabelArray& superpixels() const;
+    unsigned int numSuperpixels() const;
+
+private:
+    // accumulated terms of a superpixel and of the border between two superpixels
+    struct RegionTerms {
+        RegionTerms(): sourceCost(0.0f), sinkCost(0.0f) {}
+        float sourceCost;
+        float sinkCost;
+    };
+    struct Border {
+        vigra::UInt32 regionA;
+        vigra::UInt32 regionB;
+        float weight;
+    };
+    typedef std::vector<Border> BorderList;
+
+    void computeSuperpixels();
+    void accumulateTerms();
+    // sort by region pair and sum up the weights of equal pairs
+    static void mergeBorders(BorderList& borders);
+    void refineBand();
+
+    inline float boundaryPenalty(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1) const;
+    inline float sourceCost(unsigned int x, unsigned int y) const;
+    inline float sinkCost(unsigned int x, unsigned int y) const;
+    // the label of a seed, label for all other pixels
+    inline vigra::UInt8 seededLabel(unsigned int x, unsigned int y, vigra::UInt8 label) const;
+
+private:
+    unsigned int _superpixelSize;
+    float _intensityScaling;
+    unsigned int _refinementBandWidth;
+
+    LabelArray _superpixels;
+    unsigned int _numSuperpixels;
+    bool _superpixelsAreValid;
+
+    std::vector<RegionTerms> _regionTerms;
+    BorderList _borders;
+
+    std::vector<Graph::Node> _nodes;
+    lemon::Preflow< Graph, EdgeMap > *_preflow;
+
+    // band refinement workspace, kept between cuts. Graph and maps are cleared instead of
+    // recreated, which keeps their storage.
+    vigra::MultiArray<2, int> _bandDistance;
+    std::vector<Graph::Node> _bandNodes;
+    Graph _bandGraph;
+    EdgeMap _bandCosts;
+    Graph::NodeMap<float> _bandSourceCosts;
+    Graph::NodeMap<float> _bandSinkCosts;
+    Graph::Node _bandSourceNode;
+    Graph::Node _bandSinkNode;
+    // sized for all pixels, so the solver can stay when the band grows
+    lemon::Preflow< Graph, EdgeMap >::Elevator *_bandElevator;
+    lemon::Preflow< Graph, EdgeMap > *_bandPreflow;
+};
+
+#endif // IMAGEGRAPHSUPERPIXEL_H
@@ -0,0 +1,66 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <atomic>
+
+/**
+ * Lock-free single producer, single consumer mailbox that always holds the latest message.
+ *
+ * Triple buffered: the producer fills writeBuffer() and publishes it, the consumer picks up
+ * the most recently published buffer with receive(). Older messages that were not received
+ * in time are overwritten, neither side ever waits for the other. The buffers are reused,
+ * so messages holding vectors do not allocate once they reached their size.
+ */
+template<typename T>
+class Mailbox
+{
+public:
+    Mailbox():
+        _shared(1),
+        _writeIndex(0),
+        _readIndex(2)
+    {}
+
+    // producer side
+    T& writeBuffer()
+    {
+        return _buffers[_writeIndex];
+    }
+
+    void publish()
+    {
+        // swap the written buffer with the shared one and mark it as new
+        _writeIndex = _shared.exchange(_writeIndex | NEW_MESSAGE, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // consumer side, returns true if a message was published since the last receive()
+    bool receive()
+    {
+        if(!(_shared.load(std::memory_order_acquire) & NEW_MESSAGE))
+            return false;
+
+        _readIndex = _shared.exchange(_readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    // the message of the last successful receive()
+    const T& readBuffer() const
+    {
+        return _buffers[_readIndex];
+    }
+
+private:
+    // no copies, the indices are owned by one thread each
+    Mailbox(const Mailbox&);
+    Mailbox& operator=(const Mailbox&);
+
+    enum { INDEX_MASK = 3, NEW_MESSAGE = 4 };
+
+    T _buffers[3];
+    // index of the buffer that is neither written nor read, plus NEW_MESSAGE if it was not received yet
+    std::atomic<unsigned int> _shared;
+    unsigned int _writeIndex;
+    unsigned int _readIndex;
+};
+
+#endif // MAILBOX_H
@@ -6,14 +6,15 @@
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     _imageGraph(NULL),
-    _ui(new Ui::MainWindow)
+    _ui(new Ui::MainWindow),
+    _view(new SegmentationView)
 {
     _ui->setupUi(this);
+    _ui->imageScrollArea->setWidget(_view);
 
     QObject::connect(_ui->lambdaSlider, SIGNAL(valueChanged(int)), this, SLOT(setNewLambdaValue(int)));
     QObject::connect(_ui->sigmaSlider, SIGNAL(valueChanged(int)), this, SLOT(setNewSigmaValue(int)));
-
-    for(int i = 0; i < 256; i++) _colorTable.push_back(qRgb(i,i,i));
+    QObject::connect(_view, SIGNAL(strokeFinished(SegmentationView::Stroke,bool)), this, SLOT(addScribble(SegmentationView::Stroke,bool)));
 }
 
 MainWindow::~MainWindow()
@@ -43,6 +44,7 @@ void MainWindow::setImageGraph(ImageGraph *imageGraph)
     _imageGraph->setLambda(_ui->lambdaSlider->value());
     _imageGraph->setSigma(_ui->sigmaSlider->value());
     _imageGraph->buildGraph();
+    _view->setImages(&_imageGraph->image(), &_imageGraph->cutImage());
     processImage();
 }
 
@@ -50,11 +52,19 @@ void MainWindow::processImage()
 {
     assert(_imageGraph);
 
-    ImageGraph::ImageArray result = _imageGraph->runMinCut();
-    QImage image = QImage(result.data(), result.shape(0), result.shape(1), QImage::Format_Indexed8);
-    image.setColorTable(_colorTable);
+    // the view reads the labels straight from the graph's result buffer
+    _imageGraph->runMinCut();
+
+    const ImageGraph::Box& changedBox = _imageGraph->changedBox();
+    _view->labelsChanged(QRect(QPoint(changedBox.first.first, changedBox.first.second),
+                               QPoint(changedBox.second.first - 1, changedBox.second.second - 1)));
+}
+
+void MainWindow::addScribble(const SegmentationView::Stroke &stroke, bool foreground)
+{
+    if(!_imageGraph)
+        return;
 
-    QPixmap pixmap;
-    pixmap.convertFromImage(image);
-    _ui->imageLabel->setPixmap(pixmap);
+    _imageGraph->addSeeds(stroke, foreground ? PixelMask::FOREGROUND : PixelMask::BACKGROUND);
+    processImage();
 }
@@ -2,6 +2,7 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include "SegmentationView.h"
 class ImageGraph;
 
 namespace Ui {
@@ -21,11 +22,12 @@ public:
 public slots:
     void setNewLambdaValue(int value);
     void setNewSigmaValue(int value);
+    void addScribble(const SegmentationView::Stroke& stroke, bool foreground);
 
 private:
     Ui::MainWindow *_ui;
     ImageGraph* _imageGraph;
-    QVector<QRgb> _colorTable;
+    SegmentationView* _view;
 
     void processImage();
 };
@@ -0,0 +1,204 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+// number of threads to use for data parallel loops
+inline unsigned int numWorkerThreads()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Splits [begin, end) into numChunks contiguous chunks and calls f(chunkIndex, chunkBegin, chunkEnd)
+// for each of them, every chunk but the first on its own thread. Returns when all chunks are done.
+template<typename F>
+void parallelForChunks(unsigned int begin, unsigned int end, unsigned int numChunks, F f)
+{
+    unsigned int size = (end > begin) ? end - begin : 0;
+    numChunks = std::max(1u, std::min(numChunks, size));
+
+    std::vector<std::thread> threads;
+    threads.reserve(numChunks - 1);
+    for(unsigned int chunk = 1; chunk < numChunks; chunk++)
+    {
+        threads.push_back(std::thread(f, chunk,
+                                      begin + (unsigned int)((unsigned long long)size * chunk / numChunks),
+                                      begin + (unsigned int)((unsigned long long)size * (chunk + 1) / numChunks)));
+    }
+
+    f(0u, begin, begin + size / numChunks);
+
+    for(std::thread& t : threads)
+        t.join();
+}
+
+// Calls f(threadIndex, i) for every i in [begin, end) on numThreads threads, the calling thread
+// being thread 0. Items are handed out one at a time, which balances items of varying cost.
+template<typename F>
+void parallelForDynamic(unsigned int begin, unsigned int end, unsigned int numThreads, F f)
+{
+    unsigned int size = (end > begin) ? end - begin : 0;
+    numThreads = std::max(1u, std::min(numThreads, size));
+
+    std::atomic<unsigned int> next(begin);
+    auto work = [&](unsigned int threadIndex)
+    {
+        for(unsigned int i = next++; i < end; i = next++)
+            f(threadIndex, i);
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads - 1);
+    for(unsigned int thread = 1; thread < numThreads; thread++)
+        threads.push_back(std::thread(work, thread));
+
+    work(0u);
+
+    for(std::thread& t : threads)
+        t.join();
+}
+
+// runs both functions concurrently and returns when both are done
+template<typename F1, typename F2>
+void parallelInvoke(F1 f1, F2 f2)
+{
+    std::thread thread(f1);
+    f2();
+    thread.join();
+}
+
+// A thread that is started with the first task and then sleeps until the next one, e.g. to
+// solve the same subproblem in every iteration without starting a new thread each time.
+// Tasks that only capture a pointer or two are stored without allocating.
+class WorkerThread
+{
+public:
+    WorkerThread():
+        _hasTask(false),
+        _stop(false)
+    {}
+
+    ~WorkerThread()
+    {
+        if(!_thread.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _condition.notify_all();
+        _thread.join();
+    }
+
+    // runs task on the worker thread, the previous task has to be waited for
+    void start(const std::function<void()>& task)
+    {
+        if(!_thread.joinable())
+            _thread = std::thread(&WorkerThread::loop, this);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _task = task;
+            _hasTask = true;
+        }
+        _condition.notify_all();
+    }
+
+    // blocks until the last started task is done
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return !_hasTask; });
+    }
+
+private:
+    // no copies, the thread refers to this object
+    WorkerThread(const WorkerThread&);
+    WorkerThread& operator=(const WorkerThread&);
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while(true)
+        {
+            _condition.wait(lock, [this]() { return _hasTask || _stop; });
+            if(!_hasTask)
+                return;
+
+            lock.unlock();
+            _task();
+            lock.lock();
+
+            _hasTask = false;
+            _condition.notify_all();
+        }
+    }
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::function<void()> _task;
+    bool _hasTask;
+    bool _stop;
+    std::thread _thread;
+};
+
+// Lets threads sleep until another thread has news for them, e.g. a message in a lock-free Mailbox.
+// Read count() before checking for news and pass it to waitForChange(), then a notify() in between
+// is not lost.
+class WakeupSignal
+{
+public:
+    WakeupSignal():
+        _count(0)
+    {}
+
+    unsigned int count()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _count;
+    }
+
+    void notify()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _count++;
+        }
+        _condition.notify_all();
+    }
+
+    // blocks until notify() was called after count() returned seenCount
+    void waitForChange(unsigned int seenCount)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [&]() { return _count != seenCount; });
+    }
+
+private:
+    WakeupSignal(const WakeupSignal&);
+    WakeupSignal& operator=(const WakeupSignal&);
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    unsigned int _count;
+};
+
+// like parallelInvoke(), but f1 runs on a persistent worker thread instead of a new one
+template<typename F1, typename F2>
+void parallelInvoke(WorkerThread& worker, F1 f1, F2 f2)
+{
+    worker.start(f1);
+    f2();
+    worker.wait();
+}
+
+#endif // PARALLEL_H
@@ -1,9 +1,73 @@
 #include "PixelMask.h"
+#include "Parallel.h"
 #include <math.h>
+#include <algorithm>
+
+// don't bother starting threads for less than this many pixels each
+#define MIN_PIXELS_PER_THREAD 65536
+
+// model of a class until it has pixels to estimate one from: uniform over the gray values
+#define DEFAULT_MEAN 127.5f
+#define DEFAULT_VARIANCE (256.0f * 256.0f / 12.0f)
+
+namespace {
+    // exact integer moments of one class within a chunk of the image
+    struct Moments {
+        Moments(): numPixels(0), sum(0), sumOfSquares(0) {}
+
+        uint64_t numPixels;
+        uint64_t sum;
+        uint64_t sumOfSquares;
+    };
+
+    // branch free, so that the compiler can vectorize the row loop
+    template<bool USE_LABELS>
+    void accumulateRow(const vigra::UInt8* image,
+                       const vigra::UInt8* mask,
+                       const vigra::UInt8* labels,
+                       unsigned int width,
+                       Moments& background,
+                       Moments& foreground)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            uint64_t value = image[x];
+            uint64_t isForeground;
+            uint64_t isBackground;
+            if(USE_LABELS)
+            {
+                isForeground = (mask[x] == PixelMask::FOREGROUND) | ((mask[x] != PixelMask::BACKGROUND) & (labels[x] != 0));
+                isBackground = 1 - isForeground;
+            }
+            else
+            {
+                isForeground = (mask[x] == PixelMask::FOREGROUND);
+                isBackground = (mask[x] == PixelMask::BACKGROUND);
+            }
+
+            foreground.numPixels += isForeground;
+            foreground.sum += isForeground * value;
+            foreground.sumOfSquares += isForeground * value * value;
+            background.numPixels += isBackground;
+            background.sum += isBackground * value;
+            background.sumOfSquares += isBackground * value * value;
+        }
+    }
+}
+
+PixelMask::PixelMask():
+    _image(NULL),
+    _hasStatistics(true)
+{
+    setDefaultModel();
+}
 
 PixelMask::PixelMask(const std::string &filename, vigra::MultiArray<2, uint8_t>* image):
-    _image(image)
+    _image(image),
+    _hasStatistics(true)
 {
+    setDefaultModel();
+
     // load test image:
     vigra::ImageImportInfo imageInfo(filename.c_str());
 
@@ -22,15 +86,30 @@ PixelMask::PixelMask(const std::string &filename, vigra::MultiArray<2, uint8_t>*
          exit(-1);
     }
 
-    std::pair<float, float> statistics = computeStatisticsOfPixelsWithMask(BACKGROUND);
-    _backgroundMean = statistics.first;
-    _backgroundVariance = statistics.second;
-    std::cout << "Background statistics: mean=" << _backgroundMean << " variance=" << _backgroundVariance << std::endl;
+    computeStatistics(NULL, _backgroundStatistics, _foregroundStatistics);
+    updateModel();
+}
+
+PixelMask::PixelMask(const vigra::MultiArray<2, uint8_t> &mask, vigra::MultiArray<2, uint8_t> *image):
+    _pixelMask(mask),
+    _image(image),
+    _hasStatistics(true)
+{
+    vigra_precondition(mask.shape() == image->shape(), "PixelMask: mask and image must have the same shape");
 
-    statistics = computeStatisticsOfPixelsWithMask(FOREGROUND);
-    _foregroundMean = statistics.first;
-    _foregroundVariance = statistics.second;
-    std::cout << "Foreground statistics: mean=" << _foregroundMean << " variance=" << _foregroundVariance << std::endl;
+    setDefaultModel();
+    computeStatistics(NULL, _backgroundStatistics, _foregroundStatistics);
+    updateModel();
+}
+
+PixelMask::PixelMask(const vigra::MultiArray<2, uint8_t> &mask, vigra::MultiArray<2, uint8_t> *image, const RegionModel &model):
+    _pixelMask(mask),
+    _image(image),
+    _hasStatistics(false)
+{
+    vigra_precondition(mask.shape() == image->shape(), "PixelMask: mask and image must have the same shape");
+
+    setRegionModel(model);
 }
 
 float PixelMask::foregroundRegionPenalty(vigra::UInt8 pixelValue) const
@@ -55,40 +134,200 @@ bool PixelMask::pixelIsBackground(unsigned int x, unsigned int y) const
     return (BACKGROUND == _pixelMask(x,y));
 }
 
-std::pair<float, float> PixelMask::computeStatisticsOfPixelsWithMask(const vigra::UInt8 mask)
+void PixelMask::setPixelType(unsigned int x, unsigned int y, PixelType type)
 {
-    // compute mean
-    float mean = 0.0f;
-    unsigned int numPixels = 0;
-    for(unsigned int y = 0; y < _pixelMask.shape(1); y++)
+    vigra::UInt8& maskValue = _pixelMask(x,y);
+    if(maskValue == type)
+        return;
+
+    if(!_hasStatistics)
     {
-        for(unsigned int x = 0; x < _pixelMask.shape(0); x++)
-        {
-            if(mask == _pixelMask(x,y))
-            {
-                mean += (float)(*_image)(x,y); // / 255.0f;
-                numPixels++;
-            }
-        }
+        maskValue = type;
+        return;
     }
 
-    mean /= numPixels;
+    double pixelValue = (double)(*_image)(x,y);
+
+    ClassStatistics* oldClass = statisticsOfClass(maskValue);
+    if(oldClass)
+        oldClass->remove(pixelValue);
+
+    ClassStatistics* newClass = statisticsOfClass(type);
+    if(newClass)
+        newClass->add(pixelValue);
 
-    // compute variance
-    float variance = 0.0f;
-    for(unsigned int y = 0; y < _pixelMask.shape(1); y++)
+    maskValue = type;
+}
+
+PixelMask::ClassStatistics* PixelMask::statisticsOfClass(vigra::UInt8 mask)
+{
+    if(mask == FOREGROUND)
+        return &_foregroundStatistics;
+    else if(mask == BACKGROUND)
+        return &_backgroundStatistics;
+    else
+        return NULL;
+}
+
+void PixelMask::updateModel()
+{
+    // a given model stays until it is replaced
+    if(_hasStatistics)
+        setModel(_backgroundStatistics, _foregroundStatistics);
+}
+
+void PixelMask::reestimateModel(const vigra::MultiArray<2, vigra::UInt8> &labels)
+{
+    ClassStatistics backgroundStatistics;
+    ClassStatistics foregroundStatistics;
+    computeStatistics(&labels, backgroundStatistics, foregroundStatistics);
+    setModel(backgroundStatistics, foregroundStatistics);
+}
+
+void PixelMask::copyModel(const PixelMask &other)
+{
+    _backgroundMean = other._backgroundMean;
+    _backgroundVariance = other._backgroundVariance;
+    _foregroundMean = other._foregroundMean;
+    _foregroundVariance = other._foregroundVariance;
+}
+
+PixelMask::RegionModel PixelMask::regionModel() const
+{
+    RegionModel model;
+    model.backgroundMean = _backgroundMean;
+    model.backgroundVariance = _backgroundVariance;
+    model.foregroundMean = _foregroundMean;
+    model.foregroundVariance = _foregroundVariance;
+    return model;
+}
+
+void PixelMask::setRegionModel(const RegionModel &model)
+{
+    _backgroundMean = model.backgroundMean;
+    _backgroundVariance = model.backgroundVariance;
+    _foregroundMean = model.foregroundMean;
+    _foregroundVariance = model.foregroundVariance;
+}
+
+void PixelMask::setModel(const ClassStatistics &backgroundStatistics, const ClassStatistics &foregroundStatistics)
+{
+    setClassModel(backgroundStatistics, _backgroundMean, _backgroundVariance);
+    setClassModel(foregroundStatistics, _foregroundMean, _foregroundVariance);
+}
+
+void PixelMask::setClassModel(const ClassStatistics &statistics, float &mean, float &variance)
+{
+    // without two pixels there is no variance to estimate, e.g. a cut that labels the whole
+    // image as one class. Keep the previous model instead of installing a degenerate one.
+    if(statistics.numPixels < 2)
+        return;
+
+    mean = statistics.mean;
+    variance = statistics.variance();
+}
+
+void PixelMask::setDefaultModel()
+{
+    _backgroundMean = DEFAULT_MEAN;
+    _backgroundVariance = DEFAULT_VARIANCE;
+    _foregroundMean = DEFAULT_MEAN;
+    _foregroundVariance = DEFAULT_VARIANCE;
+}
+
+void PixelMask::ClassStatistics::add(double value)
+{
+    numPixels++;
+    double delta = value - mean;
+    mean += delta / numPixels;
+    m2 += delta * (value - mean);
+}
+
+void PixelMask::ClassStatistics::remove(double value)
+{
+    if(numPixels <= 1)
+    {
+        *this = ClassStatistics();
+        return;
+    }
+
+    // invert the Welford update
+    double oldMean = (numPixels * mean - value) / (numPixels - 1);
+    // rounding can take the difference slightly below zero
+    m2 = std::max(0.0, m2 - (value - mean) * (value - oldMean));
+    mean = oldMean;
+    numPixels--;
+}
+
+void PixelMask::ClassStatistics::merge(const ClassStatistics &other)
+{
+    if(other.numPixels == 0)
+        return;
+    if(numPixels == 0)
     {
-        for(unsigned int x = 0; x < _pixelMask.shape(0); x++)
+        // taken over exactly, so a single chunk gives the statistics of a sequential sweep
+        *this = other;
+        return;
+    }
+
+    unsigned int total = numPixels + other.numPixels;
+    double delta = other.mean - mean;
+    mean += delta * other.numPixels / total;
+    m2 += other.m2 + delta * delta * ((double)numPixels * other.numPixels / total);
+    numPixels = total;
+}
+
+float PixelMask::ClassStatistics::variance() const
+{
+    if(numPixels < 2)
+        return MIN_CLASS_VARIANCE;
+
+    // unbiased estimate
+    return std::max(MIN_CLASS_VARIANCE, (float)(std::max(0.0, m2) / (numPixels - 1.0)));
+}
+
+void PixelMask::computeStatistics(const vigra::MultiArray<2, vigra::UInt8>* labels,
+                                  ClassStatistics& backgroundStatistics,
+                                  ClassStatistics& foregroundStatistics) const
+{
+    unsigned int width = _pixelMask.shape(0);
+    unsigned int height = _pixelMask.shape(1);
+    unsigned int numChunks = std::min(numWorkerThreads(), width * height / MIN_PIXELS_PER_THREAD + 1);
+
+    std::vector<ClassStatistics> chunkBackgroundStatistics(numChunks);
+    std::vector<ClassStatistics> chunkForegroundStatistics(numChunks);
+
+    parallelForChunks(0, height, numChunks, [&](unsigned int chunk, unsigned int beginY, unsigned int endY)
+    {
+        // integer moments are exact within a chunk, chunks are combined with a stable merge
+        Moments background;
+        Moments foreground;
+        for(unsigned int y = beginY; y < endY; y++)
         {
-            if(mask == _pixelMask(x,y))
-            {
-                // variance += powf(mean - (float)(*_image)(x,y) / 255.0f, 2.0f);
-                variance += powf(mean - (float)(*_image)(x,y), 2.0f);
-            }
+            if(labels)
+                accumulateRow<true>(&(*_image)(0, y), &_pixelMask(0, y), &(*labels)(0, y), width, background, foreground);
+            else
+                accumulateRow<false>(&(*_image)(0, y), &_pixelMask(0, y), NULL, width, background, foreground);
         }
-    }
 
-    variance /= (numPixels - 1);
+        Moments* moments[2] = { &background, &foreground };
+        ClassStatistics* statistics[2] = { &chunkBackgroundStatistics[chunk], &chunkForegroundStatistics[chunk] };
+        for(int i = 0; i < 2; i++)
+        {
+            if(moments[i]->numPixels == 0)
+                continue;
+            double n = moments[i]->numPixels;
+            statistics[i]->numPixels = moments[i]->numPixels;
+            statistics[i]->mean = moments[i]->sum / n;
+            statistics[i]->m2 = moments[i]->sumOfSquares - (double)moments[i]->sum * moments[i]->sum / n;
+        }
+    });
 
-    return std::make_pair(mean, variance);
+    backgroundStatistics = ClassStatistics();
+    foregroundStatistics = ClassStatistics();
+    for(unsigned int chunk = 0; chunk < numChunks; chunk++)
+    {
+        backgroundStatistics.merge(chunkBackgroundStatistics[chunk]);
+        foregroundStatistics.merge(chunkForegroundStatistics[chunk]);
+    }
 }
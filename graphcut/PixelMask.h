@@ -5,6 +5,9 @@
 #include <vigra/multi_array.hxx>
 #include <vigra/impex.hxx>
 
+// lower bound of the variance of a class model, so that seeds of a single gray value still give finite costs
+#define MIN_CLASS_VARIANCE 1.0f
+
 class PixelMask
 {
 public:
@@ -14,8 +17,21 @@ public:
         FOREGROUND = 255
     } PixelType;
 
-    PixelMask() {}
+    // parameters of the gaussian intensity models of both classes
+    struct RegionModel {
+        float backgroundMean;
+        float backgroundVariance;
+        float foregroundMean;
+        float foregroundVariance;
+    };
+
+public:
+    PixelMask();
     PixelMask(const std::string& filename, vigra::MultiArray<2, uint8_t> *image);
+    PixelMask(const vigra::MultiArray<2, uint8_t>& mask, vigra::MultiArray<2, uint8_t> *image);
+    // with a given region model, e.g. that of the whole image for a tile of it. No statistics are
+    // computed or kept, so new seeds keep the model until setRegionModel() replaces it.
+    PixelMask(const vigra::MultiArray<2, uint8_t>& mask, vigra::MultiArray<2, uint8_t> *image, const RegionModel& model);
 
     float foregroundRegionPenalty(vigra::UInt8 pixelValue) const;
     float backgroundRegionPenalty(vigra::UInt8 pixelValue) const;
@@ -23,13 +39,56 @@ public:
     bool pixelIsForeground(unsigned int x, unsigned int y) const;
     bool pixelIsBackground(unsigned int x, unsigned int y) const;
 
+    // change the seed type of a single pixel, statistics are updated incrementally
+    void setPixelType(unsigned int x, unsigned int y, PixelType type);
+    // derive the region models from the statistics of the seeds
+    void updateModel();
+
+    // GrabCut style re-estimation: derive the region models from a cut (non-zero = foreground),
+    // seeds override the labels. Holds until the next updateModel(). A class that the cut
+    // leaves with fewer than two pixels keeps its previous model.
+    void reestimateModel(const vigra::MultiArray<2, vigra::UInt8>& labels);
+    void copyModel(const PixelMask& other);
+    // e.g. to hand the model of the whole image to a process that only knows a tile of it
+    RegionModel regionModel() const;
+    void setRegionModel(const RegionModel& model);
+
 private:
-    std::pair<float, float> computeStatisticsOfPixelsWithMask(const vigra::UInt8 mask);
+    // count, mean and sum of squared deviations of the intensities of one class (Welford)
+    struct ClassStatistics {
+        ClassStatistics(): numPixels(0), mean(0.0), m2(0.0) {}
+
+        void add(double value);
+        void remove(double value);
+        // combine with the statistics of a disjoint set of pixels (Chan et al.)
+        void merge(const ClassStatistics& other);
+
+        float variance() const;
+
+        unsigned int numPixels;
+        double mean;
+        double m2;
+    };
+
+    // computes the statistics of both classes in one parallel sweep over the image.
+    // Classes are given by the mask, or by the labels where the mask is not set if labels are given.
+    void computeStatistics(const vigra::MultiArray<2, vigra::UInt8>* labels,
+                           ClassStatistics& backgroundStatistics,
+                           ClassStatistics& foregroundStatistics) const;
+    ClassStatistics* statisticsOfClass(vigra::UInt8 mask);
+    void setModel(const ClassStatistics& backgroundStatistics, const ClassStatistics& foregroundStatistics);
+    static void setClassModel(const ClassStatistics& statistics, float& mean, float& variance);
+    void setDefaultModel();
 
 private:
     vigra::MultiArray<2, vigra::UInt8> _pixelMask;
     vigra::MultiArray<2, vigra::UInt8>* _image;
 
+    // false if the model was given instead of derived from the seeds
+    bool _hasStatistics;
+    ClassStatistics _backgroundStatistics;
+    ClassStatistics _foregroundStatistics;
+
     float _backgroundMean;
     float _backgroundVariance;
 
@@ -0,0 +1,273 @@
+#ifndef QUANTIZEDPREFLOW_H
+#define QUANTIZEDPREFLOW_H
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// lemon includes
+#include <lemon/preflow.h>
+
+/**
+ * Preflow traits for integer capacities. Capacities are stored as CAPACITY, flows and
+ * excesses as the wider FLOW, as the sink collects the flow of all nodes.
+ */
+template<typename GR, typename CAPACITY, typename FLOW>
+struct QuantizedPreflowTraits
+{
+    typedef GR Digraph;
+    typedef typename GR::template EdgeMap<CAPACITY> CapacityMap;
+    typedef FLOW Value;
+
+    typedef typename GR::template ArcMap<FLOW> FlowMap;
+    static FlowMap* createFlowMap(const Digraph& digraph)
+    {
+        return new FlowMap(digraph);
+    }
+
+    typedef lemon::LinkedElevator<GR, typename GR::Node> Elevator;
+    static Elevator* createElevator(const Digraph& digraph, int maxLevel)
+    {
+        return new Elevator(digraph, maxLevel);
+    }
+
+    typedef lemon::Tolerance<FLOW> Tolerance;
+};
+
+/**
+ * Min-cut on integer capacities: the float costs are scaled and rounded to the integer type,
+ * the max-flow runs on integers only, so the cut only depends on the rounded capacities.
+ *
+ * The capacity map, flow and solver are allocated once and live as long as the topology of the
+ * graph. After quantize() single edges can be re-quantized when their cost changed, then the
+ * next cut continues from the flow of the last one. This base class lets callers choose the
+ * integer types at runtime, see QuantizedMinCutSolver for the implementation.
+ */
+template<typename GR, typename COSTS>
+class QuantizedMinCut
+{
+public:
+    typedef typename GR::Node Node;
+    typedef typename GR::Edge Edge;
+
+    virtual ~QuantizedMinCut() {}
+
+    // Largest scale at which the costs, and the flows they allow, fit the integer types. It is
+    // rounded down to a power of two, so small cost changes keep the scale and the last flow.
+    virtual double maxScale(const COSTS& costs) const = 0;
+    // scale used by the last quantize(), 0 before
+    virtual double scale() const = 0;
+
+    // quantize all costs, the next cut starts from scratch
+    virtual void quantize(const COSTS& costs, double scale) = 0;
+    // re-quantize one edge with the current scale, capacities beyond the integer range saturate
+    virtual void updateEdge(Edge e, float cost) = 0;
+    // same for the two terminal edges of one node, raising both keeps the last flow valid
+    virtual void updateTerminalEdges(Edge sourceEdge, Edge sinkEdge, float sourceCost, float sinkCost) = 0;
+    // false once updates raised the terminal capacities so far that the total flow may overflow
+    // FLOW, then the costs have to be quantized again with a new maxScale()
+    virtual bool flowFits() const = 0;
+
+    // after nodes or edges were added or removed, or the terminals changed
+    virtual void updateTopology(Node source, Node sink) = 0;
+
+    virtual void run() = 0;
+    // true if n is on the source side of the last cut
+    virtual bool minCut(Node n) const = 0;
+};
+
+template<typename GR, typename COSTS, typename CAPACITY, typename FLOW>
+class QuantizedMinCutSolver : public QuantizedMinCut<GR, COSTS>
+{
+public:
+    typedef typename GR::Node Node;
+    typedef typename GR::Edge Edge;
+    typedef QuantizedPreflowTraits<GR, CAPACITY, FLOW> Traits;
+
+    // maxNodes bounds the number of nodes for all topologies the graph will have
+    QuantizedMinCutSolver(const GR& graph, Node source, Node sink, int maxNodes):
+        _graph(graph),
+        _source(source),
+        _sink(sink),
+        _capacities(graph),
+        _flow(graph),
+        _elevator(graph, maxNodes),
+        _preflow(graph, _capacities, source, sink),
+        _scale(0.0),
+        _maxDegree(0),
+        _sourceCapacity(0.0),
+        _sinkCapacity(0.0),
+        _flowIsValid(false)
+    {
+        _preflow.elevator(_elevator);
+        _preflow.flowMap(_flow);
+        updateTopology(source, sink);
+    }
+
+    virtual double maxScale(const COSTS& costs) const
+    {
+        float maxCost = 0.0f;
+        for(typename GR::EdgeIt e(_graph); e != lemon::INVALID; ++e)
+            maxCost = std::max(maxCost, std::fabs(costs[e]));
+
+        double sourceCapacity = 0.0;
+        for(typename GR::OutArcIt a(_graph, _source); a != lemon::INVALID; ++a)
+            sourceCapacity += std::max(0.0f, costs[a]);
+
+        double sinkCapacity = 0.0;
+        for(typename GR::OutArcIt a(_graph, _sink); a != lemon::INVALID; ++a)
+            sinkCapacity += std::max(0.0f, costs[a]);
+
+        // The largest cost maps to the largest CAPACITY. The excess of a node is bounded by
+        // degree * maxCost, that of the sink by the total flow, both have to fit into FLOW.
+        // The total flow gets twice the room, as later updates may raise terminal capacities.
+        double scale = 1.0;
+        if(maxCost > 0.0f)
+            scale = std::numeric_limits<CAPACITY>::max() / (double)maxCost;
+
+        double maxFlow = std::max((double)_maxDegree * maxCost, 2.0 * std::min(sourceCapacity, sinkCapacity));
+        if(maxFlow > 0.0)
+            scale = std::min(scale, std::numeric_limits<FLOW>::max() / maxFlow);
+
+        return std::ldexp(1.0, std::ilogb(scale));
+    }
+
+    virtual double scale() const
+    {
+        return _scale;
+    }
+
+    virtual void quantize(const COSTS& costs, double scale)
+    {
+        _scale = scale;
+        for(typename GR::EdgeIt e(_graph); e != lemon::INVALID; ++e)
+            _capacities[e] = quantizeCost(costs[e]);
+        _flowIsValid = false;
+
+        _sourceCapacity = 0.0;
+        for(typename GR::OutArcIt a(_graph, _source); a != lemon::INVALID; ++a)
+            _sourceCapacity += std::max(CAPACITY(0), _capacities[a]);
+
+        _sinkCapacity = 0.0;
+        for(typename GR::OutArcIt a(_graph, _sink); a != lemon::INVALID; ++a)
+            _sinkCapacity += std::max(CAPACITY(0), _capacities[a]);
+    }
+
+    virtual void updateEdge(Edge e, float cost)
+    {
+        CAPACITY capacity = quantizeCost(cost);
+        if(_flowIsValid && arcFlow(e) > capacity)
+            _flowIsValid = false;
+        setCapacity(e, capacity);
+    }
+
+    virtual void updateTerminalEdges(Edge sourceEdge, Edge sinkEdge, float sourceCost, float sinkCost)
+    {
+        FLOW sourceCapacity = quantizeCost(sourceCost);
+        FLOW sinkCapacity = quantizeCost(sinkCost);
+
+        if(_flowIsValid)
+        {
+            // like ImageGraphPrimal::setTerminalCosts(), unless the raised capacities do not fit
+            FLOW shift = std::max(FLOW(0), std::max(arcFlow(sourceEdge) - sourceCapacity, arcFlow(sinkEdge) - sinkCapacity));
+            if(std::max(sourceCapacity, sinkCapacity) + shift <= std::numeric_limits<CAPACITY>::max())
+            {
+                sourceCapacity += shift;
+                sinkCapacity += shift;
+            }
+            else
+            {
+                _flowIsValid = false;
+            }
+        }
+
+        setCapacity(sourceEdge, (CAPACITY)sourceCapacity);
+        setCapacity(sinkEdge, (CAPACITY)sinkCapacity);
+    }
+
+    virtual bool flowFits() const
+    {
+        // the flow into the sink is bounded by the capacity leaving the source and entering the sink
+        return std::min(_sourceCapacity, _sinkCapacity) <= (double)std::numeric_limits<FLOW>::max();
+    }
+
+    virtual void updateTopology(Node source, Node sink)
+    {
+        _source = source;
+        _sink = sink;
+        _preflow.source(source);
+        _preflow.target(sink);
+        _flowIsValid = false;
+
+        _maxDegree = 0;
+        for(typename GR::NodeIt n(_graph); n != lemon::INVALID; ++n)
+        {
+            if(n == source || n == sink)
+                continue;
+
+            unsigned int degree = 0;
+            for(typename GR::OutArcIt a(_graph, n); a != lemon::INVALID; ++a)
+                degree++;
+            _maxDegree = std::max(_maxDegree, degree);
+        }
+    }
+
+    virtual void run()
+    {
+        if(!flowFits())
+            _flowIsValid = false;
+
+        if(!_flowIsValid || !_preflow.init(_flow))
+            _preflow.init();
+        _preflow.startFirstPhase();
+        _flowIsValid = true;
+    }
+
+    virtual bool minCut(Node n) const
+    {
+        return _preflow.minCut(n);
+    }
+
+private:
+    CAPACITY quantizeCost(float cost) const
+    {
+        double capacity = std::floor(cost * _scale + 0.5);
+        double limit = std::numeric_limits<CAPACITY>::max();
+        return (CAPACITY)std::max(-limit, std::min(capacity, limit));
+    }
+
+    // keeps the total capacity at the terminals up to date
+    void setCapacity(Edge e, CAPACITY capacity)
+    {
+        double change = (double)std::max(CAPACITY(0), capacity) - std::max(CAPACITY(0), _capacities[e]);
+        if(_graph.u(e) == _source || _graph.v(e) == _source)
+            _sourceCapacity += change;
+        if(_graph.u(e) == _sink || _graph.v(e) == _sink)
+            _sinkCapacity += change;
+        _capacities[e] = capacity;
+    }
+
+    FLOW arcFlow(Edge e) const
+    {
+        return std::max(_flow[_graph.direct(e, true)], _flow[_graph.direct(e, false)]);
+    }
+
+private:
+    const GR& _graph;
+    Node _source;
+    Node _sink;
+
+    typename Traits::CapacityMap _capacities;
+    typename Traits::FlowMap _flow;
+    typename Traits::Elevator _elevator;
+    lemon::Preflow< GR, typename Traits::CapacityMap, Traits > _preflow;
+
+    double _scale;
+    unsigned int _maxDegree;
+    // total quantized capacity of the edges at the source and at the sink
+    double _sourceCapacity;
+    double _sinkCapacity;
+    bool _flowIsValid;
+};
+
+#endif // QUANTIZEDPREFLOW_H
@@ -0,0 +1,219 @@
+#include "SegmentationView.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <algorithm>
+#include <math.h>
+
+// edge length of the cached tiles in image pixels
+#define TILE_SIZE 256
+
+// radius of the scribble brush in image pixels
+static const int BRUSH_RADIUS = 2;
+
+static const float MIN_ZOOM = 0.125f;
+static const float MAX_ZOOM = 16.0f;
+
+SegmentationView::SegmentationView(QWidget *parent) :
+    QWidget(parent),
+    _image(NULL),
+    _labels(NULL),
+    _zoom(1.0f),
+    _numTilesX(0),
+    _numTilesY(0),
+    _isPainting(false),
+    _strokeIsForeground(true)
+{
+    // foreground is blended with half transparent red
+    for(int i = 0; i < 256; i++)
+    {
+        _plainColors[i] = qRgb(i, i, i);
+        _overlayColors[i] = qRgb(i / 2 + 128, i / 2, i / 2);
+    }
+
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void SegmentationView::setImages(const ImageArray *image, const ImageArray *labels)
+{
+    _image = image;
+    _labels = labels;
+
+    _numTilesX = (_image->shape(0) + TILE_SIZE - 1) / TILE_SIZE;
+    _numTilesY = (_image->shape(1) + TILE_SIZE - 1) / TILE_SIZE;
+    _tiles.assign(_numTilesX * _numTilesY, QImage());
+    _tileIsValid.assign(_numTilesX * _numTilesY, false);
+
+    setZoom(_zoom);
+}
+
+void SegmentationView::labelsChanged(const QRect &region)
+{
+    if(!_image || region.isEmpty())
+        return;
+
+    // tiles that have been rendered before are patched right away, only where the labels changed.
+    // The others are rendered completely once they become visible.
+    for(unsigned int tileY = region.top() / TILE_SIZE; tileY <= (unsigned int)region.bottom() / TILE_SIZE; tileY++)
+    {
+        for(unsigned int tileX = region.left() / TILE_SIZE; tileX <= (unsigned int)region.right() / TILE_SIZE; tileX++)
+        {
+            if(_tileIsValid[tileY * _numTilesX + tileX])
+                renderTile(tileX, tileY, region);
+        }
+    }
+
+    update(QRect(floorf(region.x() * _zoom),
+                 floorf(region.y() * _zoom),
+                 ceilf(region.width() * _zoom) + 1,
+                 ceilf(region.height() * _zoom) + 1));
+}
+
+float SegmentationView::zoom() const
+{
+    return _zoom;
+}
+
+void SegmentationView::setZoom(float zoom)
+{
+    _zoom = std::max(MIN_ZOOM, std::min(MAX_ZOOM, zoom));
+
+    if(_image)
+        setFixedSize(ceilf(_image->shape(0) * _zoom), ceilf(_image->shape(1) * _zoom));
+    update();
+}
+
+QRect SegmentationView::tileRect(unsigned int tileX, unsigned int tileY) const
+{
+    QRect imageRect(0, 0, _image->shape(0), _image->shape(1));
+    return QRect(tileX * TILE_SIZE, tileY * TILE_SIZE, TILE_SIZE, TILE_SIZE).intersected(imageRect);
+}
+
+void SegmentationView::renderTile(unsigned int tileX, unsigned int tileY, const QRect &region)
+{
+    QRect rect = tileRect(tileX, tileY);
+    QImage& tile = _tiles[tileY * _numTilesX + tileX];
+    if(tile.isNull())
+        tile = QImage(rect.width(), rect.height(), QImage::Format_RGB32);
+
+    QRect dirty = rect.intersected(region);
+    for(int y = dirty.top(); y <= dirty.bottom(); y++)
+    {
+        const vigra::UInt8* imageRow = &(*_image)(0, y);
+        const vigra::UInt8* labelRow = &(*_labels)(0, y);
+        QRgb* tileRow = reinterpret_cast<QRgb*>(tile.scanLine(y - rect.top()));
+
+        for(int x = dirty.left(); x <= dirty.right(); x++)
+        {
+            tileRow[x - rect.left()] = labelRow[x] ? _overlayColors[imageRow[x]] : _plainColors[imageRow[x]];
+        }
+    }
+}
+
+void SegmentationView::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    if(!_image)
+    {
+        painter.fillRect(event->rect(), Qt::black);
+        return;
+    }
+
+    // only the tiles intersecting the exposed part of the widget are touched
+    QRect exposed = event->rect();
+    unsigned int firstTileX = std::max(0.0f, floorf(exposed.left() / _zoom)) / TILE_SIZE;
+    unsigned int firstTileY = std::max(0.0f, floorf(exposed.top() / _zoom)) / TILE_SIZE;
+    unsigned int lastTileX = std::min<unsigned int>(_numTilesX - 1, floorf(exposed.right() / _zoom) / TILE_SIZE);
+    unsigned int lastTileY = std::min<unsigned int>(_numTilesY - 1, floorf(exposed.bottom() / _zoom) / TILE_SIZE);
+
+    painter.scale(_zoom, _zoom);
+
+    for(unsigned int tileY = firstTileY; tileY <= lastTileY; tileY++)
+    {
+        for(unsigned int tileX = firstTileX; tileX <= lastTileX; tileX++)
+        {
+            unsigned int index = tileY * _numTilesX + tileX;
+            if(!_tileIsValid[index])
+            {
+                renderTile(tileX, tileY, tileRect(tileX, tileY));
+                _tileIsValid[index] = true;
+            }
+
+            painter.drawImage(QPoint(tileX * TILE_SIZE, tileY * TILE_SIZE), _tiles[index]);
+        }
+    }
+}
+
+void SegmentationView::mousePressEvent(QMouseEvent *event)
+{
+    if(!_image)
+        return;
+
+    _isPainting = true;
+    _strokeIsForeground = (event->button() != Qt::RightButton);
+    _stroke.clear();
+    _lastStrokePosition = toImageCoordinates(event->pos());
+    addStrokeSegment(_lastStrokePosition, _lastStrokePosition);
+}
+
+void SegmentationView::mouseMoveEvent(QMouseEvent *event)
+{
+    if(!_isPainting)
+        return;
+
+    QPoint position = toImageCoordinates(event->pos());
+    addStrokeSegment(_lastStrokePosition, position);
+    _lastStrokePosition = position;
+}
+
+void SegmentationView::mouseReleaseEvent(QMouseEvent *)
+{
+    if(!_isPainting)
+        return;
+    _isPainting = false;
+
+    // the brush overlaps itself along the stroke
+    std::sort(_stroke.begin(), _stroke.end());
+    _stroke.erase(std::unique(_stroke.begin(), _stroke.end()), _stroke.end());
+
+    emit strokeFinished(_stroke, _strokeIsForeground);
+}
+
+void SegmentationView::wheelEvent(QWheelEvent *event)
+{
+    setZoom(event->delta() > 0 ? _zoom * 1.25f : _zoom / 1.25f);
+}
+
+QPoint SegmentationView::toImageCoordinates(const QPoint &widgetPosition) const
+{
+    return QPoint(floorf(widgetPosition.x() / _zoom), floorf(widgetPosition.y() / _zoom));
+}
+
+void SegmentationView::addStrokeSegment(const QPoint &from, const QPoint &to)
+{
+    int width = _image->shape(0);
+    int height = _image->shape(1);
+
+    QPoint delta = to - from;
+    int numSteps = std::max(std::abs(delta.x()), std::abs(delta.y()));
+
+    for(int step = 0; step <= numSteps; step++)
+    {
+        QPoint center = from;
+        if(numSteps > 0)
+            center += delta * step / numSteps;
+
+        for(int dy = -BRUSH_RADIUS; dy <= BRUSH_RADIUS; dy++)
+        {
+            for(int dx = -BRUSH_RADIUS; dx <= BRUSH_RADIUS; dx++)
+            {
+                int x = center.x() + dx;
+                int y = center.y() + dy;
+                if(dx * dx + dy * dy > BRUSH_RADIUS * BRUSH_RADIUS || x < 0 || y < 0 || x >= width || y >= height)
+                    continue;
+                _stroke.push_back(std::make_pair((unsigned int)x, (unsigned int)y));
+            }
+        }
+    }
+}
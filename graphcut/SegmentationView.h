@@ -0,0 +1,77 @@
+#ifndef SEGMENTATIONVIEW_H
+#define SEGMENTATIONVIEW_H
+
+#include <QWidget>
+#include <QImage>
+#include <vector>
+#include <utility>
+#include <vigra/multi_array.hxx>
+
+/**
+ * Shows an image with the current segmentation as a transparent overlay.
+ *
+ * Image and labels are read directly from the buffers owned by the ImageGraph,
+ * the view only caches the composited tiles that have been visible so far.
+ * Left mouse strokes paint foreground, right mouse strokes background scribbles,
+ * the mouse wheel zooms.
+ */
+class SegmentationView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    typedef vigra::MultiArray<2, vigra::UInt8> ImageArray;
+    typedef std::vector< std::pair<unsigned int, unsigned int> > Stroke;
+
+public:
+    explicit SegmentationView(QWidget *parent = 0);
+
+    // both buffers must outlive the view, labels are expected to be 0 or 255
+    void setImages(const ImageArray* image, const ImageArray* labels);
+
+    // re-render the overlay inside the given image region, after the labels changed there
+    void labelsChanged(const QRect& region);
+
+    float zoom() const;
+    void setZoom(float zoom);
+
+signals:
+    void strokeFinished(const SegmentationView::Stroke& stroke, bool foreground);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void mouseReleaseEvent(QMouseEvent *event);
+    void wheelEvent(QWheelEvent *event);
+
+private:
+    QRect tileRect(unsigned int tileX, unsigned int tileY) const;
+    // composite image and labels into the part of a tile covered by region
+    void renderTile(unsigned int tileX, unsigned int tileY, const QRect& region);
+    QPoint toImageCoordinates(const QPoint& widgetPosition) const;
+    void addStrokeSegment(const QPoint& from, const QPoint& to);
+
+private:
+    const ImageArray* _image;
+    const ImageArray* _labels;
+    float _zoom;
+
+    // colors of unlabeled and foreground pixels, indexed by gray value
+    QRgb _plainColors[256];
+    QRgb _overlayColors[256];
+
+    // composited tiles, rendered on demand when they become visible
+    unsigned int _numTilesX;
+    unsigned int _numTilesY;
+    std::vector<QImage> _tiles;
+    std::vector<bool> _tileIsValid;
+
+    // current scribble
+    bool _isPainting;
+    bool _strokeIsForeground;
+    QPoint _lastStrokePosition;
+    Stroke _stroke;
+};
+
+#endif // SEGMENTATIONVIEW_H
@@ -0,0 +1,125 @@
+#include "TileProtocol.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <cerrno>
+
+namespace {
+
+// header of every message: uint32 type and uint64 payload size, without padding.
+// Payloads grow with the tile, so their size does not have to fit 32 bits.
+const size_t HEADER_SIZE = sizeof(uint32_t) + sizeof(uint64_t);
+
+bool sendAll(int fd, const char* data, size_t size)
+{
+    while(size > 0)
+    {
+        // no SIGPIPE if the other end died, the caller sees the error instead
+        ssize_t numBytes = ::send(fd, data, size, MSG_NOSIGNAL);
+        if(numBytes < 0 && errno == EINTR)
+            continue;
+        if(numBytes <= 0)
+            return false;
+
+        data += numBytes;
+        size -= numBytes;
+    }
+    return true;
+}
+
+bool receiveAll(int fd, char* data, size_t size)
+{
+    while(size > 0)
+    {
+        ssize_t numBytes = ::recv(fd, data, size, 0);
+        if(numBytes < 0 && errno == EINTR)
+            continue;
+        if(numBytes <= 0)
+            return false;
+
+        data += numBytes;
+        size -= numBytes;
+    }
+    return true;
+}
+
+} // namespace
+
+size_t maxTilePayloadSize(unsigned int width, unsigned int height)
+{
+    return 1024 + sizeof(uint32_t) * (size_t)width * height;
+}
+
+TileMessage::TileMessage():
+    _type(TILE_SHUTDOWN),
+    _readPosition(0),
+    _isValid(true)
+{
+}
+
+void TileMessage::reset(TileMessageType type)
+{
+    _type = type;
+    _payload.clear();
+    _readPosition = 0;
+    _isValid = true;
+}
+
+TileMessageType TileMessage::type() const
+{
+    return _type;
+}
+
+bool TileMessage::isValid() const
+{
+    return _isValid;
+}
+
+void TileMessage::appendBytes(const void *data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    _payload.insert(_payload.end(), bytes, bytes + size);
+}
+
+bool TileMessage::readBytes(void *data, size_t size)
+{
+    if(!_isValid || _readPosition + size > _payload.size())
+    {
+        _isValid = false;
+        return false;
+    }
+
+    if(size > 0)
+        memcpy(data, &_payload[_readPosition], size);
+    _readPosition += size;
+    return true;
+}
+
+bool TileMessage::send(int fd) const
+{
+    uint32_t type = _type;
+    uint64_t size = _payload.size();
+    char header[HEADER_SIZE];
+    memcpy(header, &type, sizeof(type));
+    memcpy(header + sizeof(type), &size, sizeof(size));
+
+    return sendAll(fd, header, HEADER_SIZE) &&
+           sendAll(fd, _payload.data(), _payload.size());
+}
+
+bool TileMessage::receive(int fd, size_t maxPayloadSize)
+{
+    char header[HEADER_SIZE];
+    if(!receiveAll(fd, header, HEADER_SIZE))
+        return false;
+
+    uint32_t type;
+    uint64_t size;
+    memcpy(&type, header, sizeof(type));
+    memcpy(&size, header + sizeof(type), sizeof(size));
+    if(size > maxPayloadSize)
+        return false;
+
+    reset((TileMessageType)type);
+    _payload.resize(size);
+    return receiveAll(fd, _payload.data(), _payload.size());
+}
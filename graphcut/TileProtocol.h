@@ -0,0 +1,107 @@
+#ifndef TILEPROTOCOL_H
+#define TILEPROTOCOL_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Binary messages between the coordinator of a multi-process dual decomposition and the
+ * workers that own one tile each, sent over a stream socket.
+ *
+ * Every message is a header of a uint32 type and a uint64 payload size in bytes, followed by
+ * the payload. Values are written in host byte order, so both ends have to share the architecture.
+ *
+ *  SETUP        coordinator -> worker  width, height, number of seams (at most 2), their columns
+ *                                      in tile coordinates from left to right, lambda, sigma,
+ *                                      PixelMask::RegionModel of the whole image,
+ *                                      width * height image bytes, width * height mask bytes
+ *  PARAMETERS   coordinator -> worker  lambda, sigma, PixelMask::RegionModel, the costs are
+ *                                      rebuilt before the next cut
+ *  SEEDS        coordinator -> worker  uint8 PixelMask::PixelType, PixelMask::RegionModel after
+ *                                      adding them, count, count uint32 pixel indices y * width + x
+ *  LAGRANGIANS  coordinator -> worker  count, count floats: height per seam, already negated
+ *                                      where the tile lies right of the seam
+ *  LABELS       worker -> coordinator  count, count uint64 label words of the new cut: (height + 63) / 64
+ *                                      per seam
+ *  GET_RESULT   coordinator -> worker  empty
+ *  RESULT       worker -> coordinator  width * height label bytes of the last cut
+ *  SHUTDOWN     coordinator -> worker  empty, the worker exits
+ *
+ * Payloads are limited by maxTilePayloadSize(), a receiver drops the connection on larger ones.
+ */
+typedef enum {
+    TILE_SETUP = 1,
+    TILE_LAGRANGIANS,
+    TILE_LABELS,
+    TILE_GET_RESULT,
+    TILE_RESULT,
+    TILE_SHUTDOWN,
+    TILE_PARAMETERS,
+    TILE_SEEDS
+} TileMessageType;
+
+// upper bound on the payload of any message for a tile of the given size: SEEDS with
+// at most one index per pixel is the largest, plus room for the fixed fields
+size_t maxTilePayloadSize(unsigned int width, unsigned int height);
+
+class TileMessage
+{
+public:
+    TileMessage();
+
+    // start a new message of the given type, keeps the allocated payload buffer
+    void reset(TileMessageType type);
+    TileMessageType type() const;
+
+    // serialization, values are read back in the order they were appended
+    template<typename T> void append(const T& value);
+    template<typename T> void appendArray(const T* values, unsigned int count);
+    template<typename T> T read();
+    template<typename T> void readArray(T* values, unsigned int count);
+    // false if the payload was shorter than what has been read so far
+    bool isValid() const;
+
+    // blocking, return false if the socket failed or was closed by the other end.
+    // receive() also fails on payloads larger than maxPayloadSize, before allocating them.
+    bool send(int fd) const;
+    bool receive(int fd, size_t maxPayloadSize);
+
+private:
+    void appendBytes(const void* data, size_t size);
+    bool readBytes(void* data, size_t size);
+
+private:
+    TileMessageType _type;
+    std::vector<char> _payload;
+    size_t _readPosition;
+    bool _isValid;
+};
+
+template<typename T>
+void TileMessage::append(const T& value)
+{
+    appendBytes(&value, sizeof(T));
+}
+
+template<typename T>
+void TileMessage::appendArray(const T* values, unsigned int count)
+{
+    appendBytes(values, count * sizeof(T));
+}
+
+template<typename T>
+T TileMessage::read()
+{
+    T value = T();
+    readBytes(&value, sizeof(T));
+    return value;
+}
+
+template<typename T>
+void TileMessage::readArray(T* values, unsigned int count)
+{
+    readBytes(values, count * sizeof(T));
+}
+
+#endif // TILEPROTOCOL_H
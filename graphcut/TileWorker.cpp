@@ -0,0 +1,206 @@
+#include "TileWorker.h"
+#include "TileProtocol.h"
+#include "ImageGraphPrimal.h"
+#include <cstdlib>
+
+int runTileWorker(int fd, unsigned int width, unsigned int height)
+{
+    TileMessage message;
+    size_t maxPayloadSize = maxTilePayloadSize(width, height);
+    ImageGraphPrimal* graph = NULL;
+    bool graphIsBuilt = false;
+    std::vector<unsigned int> seamColumns;
+    std::vector<float> lagrangians;
+    ImageGraphPrimal::LabelBits labels;
+    ImageGraphPrimal::LabelBits seamLabels;
+    std::vector<uint32_t> seedIndices;
+    std::vector<ImageGraph::Coordinate> seeds;
+
+    while(message.receive(fd, maxPayloadSize))
+    {
+        switch(message.type())
+        {
+        case TILE_SETUP:
+        {
+            unsigned int setupWidth = message.read<uint32_t>();
+            unsigned int setupHeight = message.read<uint32_t>();
+            uint32_t numSeams = message.read<uint32_t>();
+            seamColumns.resize(std::min<uint32_t>(numSeams, 2));
+            message.readArray(seamColumns.data(), seamColumns.size());
+            float lambda = message.read<float>();
+            float sigma = message.read<float>();
+            PixelMask::RegionModel regionModel = message.read<PixelMask::RegionModel>();
+            if(setupWidth != width || setupHeight != height)
+            {
+                std::cerr << "Tile worker: setup for a tile of another size" << std::endl;
+                delete graph;
+                return EXIT_FAILURE;
+            }
+
+            // at most one seam on each end of the tile
+            bool seamsAreValid = numSeams == seamColumns.size();
+            for(unsigned int i = 0; i < seamColumns.size(); i++)
+                seamsAreValid &= seamColumns[i] < width && (i == 0 || seamColumns[i - 1] < seamColumns[i]);
+            if(!seamsAreValid)
+            {
+                std::cerr << "Tile worker: invalid seams" << std::endl;
+                delete graph;
+                return EXIT_FAILURE;
+            }
+
+            ImageGraph::ImageArray image(vigra::Shape2(width, height));
+            ImageGraph::ImageArray mask(vigra::Shape2(width, height));
+            message.readArray(image.data(), width * height);
+            message.readArray(mask.data(), width * height);
+            if(!message.isValid())
+            {
+                std::cerr << "Tile worker: invalid setup message" << std::endl;
+                delete graph;
+                return EXIT_FAILURE;
+            }
+
+            // only sent once per worker, later changes arrive as PARAMETERS and SEEDS.
+            // The model of the whole image is used as is, the tile's own statistics are never computed.
+            delete graph;
+            graph = new ImageGraphPrimal(image, mask, regionModel);
+            graph->setLoggingEnabled(false);
+            graph->setSeamColumns(seamColumns);
+            graph->setLambda(lambda);
+            graph->setSigma(sigma);
+            graphIsBuilt = false;
+            break;
+        }
+
+        case TILE_PARAMETERS:
+        {
+            float lambda = message.read<float>();
+            float sigma = message.read<float>();
+            PixelMask::RegionModel regionModel = message.read<PixelMask::RegionModel>();
+            if(!graph || !message.isValid())
+            {
+                std::cerr << "Tile worker: parameters without setup or invalid" << std::endl;
+                delete graph;
+                return EXIT_FAILURE;
+            }
+
+            graph->setLambda(lambda);
+            graph->setSigma(sigma);
+            PixelMask model;
+            model.setRegionModel(regionModel);
+            graph->copyModel(model);
+
+            // the costs are rebuilt with the next multipliers, nodes and edges are kept
+            graphIsBuilt = false;
+            break;
+        }
+
+        case TILE_SEEDS:
+        {
+            vigra::UInt8 type = message.read<vigra::UInt8>();
+            PixelMask::RegionModel regionModel = message.read<PixelMask::RegionModel>();
+            uint32_t count = message.read<uint32_t>();
+            seedIndices.resize(std::min<size_t>(count, width * height));
+            message.readArray(seedIndices.data(), seedIndices.size());
+
+            bool isValid = graph && message.isValid() && count == seedIndices.size() &&
+                           (type == PixelMask::NONE || type == PixelMask::BACKGROUND || type == PixelMask::FOREGROUND);
+            seeds.clear();
+            for(uint32_t index : seedIndices)
+            {
+                isValid &= index < width * height;
+                seeds.push_back(ImageGraph::Coordinate(index % width, index / width));
+            }
+
+            if(!isValid)
+            {
+                std::cerr << "Tile worker: seeds without setup or invalid" << std::endl;
+                delete graph;
+                return EXIT_FAILURE;
+            }
+
+            // same as ImageGraphDual: the model of the whole image, and new terminal edges for the seeds only
+            PixelMask model;
+            model.setRegionModel(regionModel);
+            graph->copyModel(model);
+            graph->addSeeds(seeds, (PixelMask::PixelType)type);
+            break;
+        }
+
+        case TILE_LAGRANGIANS:
+        {
+            // one multiplier per row of each seam, anything else is not allocated
+            uint32_t count = message.read<uint32_t>();
+            size_t numLagrangians = seamColumns.size() * height;
+            lagrangians.resize(count == numLagrangians ? numLagrangians : 0);
+            message.readArray(lagrangians.data(), lagrangians.size());
+            if(!graph || !message.isValid() || count != numLagrangians)
+            {
+                std::cerr << "Tile worker: multipliers without setup or invalid" << std::endl;
+                delete graph;
+                return EXIT_FAILURE;
+            }
+
+            if(graphIsBuilt)
+            {
+                graph->updateLagrangians(lagrangians);
+            }
+            else
+            {
+                graph->setLagrangians(lagrangians);
+                graph->buildGraph();
+                graphIsBuilt = true;
+            }
+            graph->runMinCut();
+            labels.clear();
+            for(unsigned int seamX : seamColumns)
+            {
+                graph->extractColumnLabels(seamX, seamLabels);
+                labels.insert(labels.end(), seamLabels.begin(), seamLabels.end());
+            }
+
+            message.reset(TILE_LABELS);
+            message.append<uint32_t>(labels.size());
+            message.appendArray(labels.data(), labels.size());
+            if(!message.send(fd))
+            {
+                delete graph;
+                return EXIT_FAILURE;
+            }
+            break;
+        }
+
+        case TILE_GET_RESULT:
+        {
+            if(!graphIsBuilt)
+            {
+                std::cerr << "Tile worker: result requested before the first cut" << std::endl;
+                delete graph;
+                return EXIT_FAILURE;
+            }
+
+            const ImageGraph::ImageArray& result = graph->cutImage();
+            message.reset(TILE_RESULT);
+            message.appendArray(result.data(), result.size());
+            if(!message.send(fd))
+            {
+                delete graph;
+                return EXIT_FAILURE;
+            }
+            break;
+        }
+
+        case TILE_SHUTDOWN:
+            delete graph;
+            return EXIT_SUCCESS;
+
+        default:
+            std::cerr << "Tile worker: unexpected message " << message.type() << std::endl;
+            delete graph;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // the coordinator went away
+    delete graph;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,17 @@
+#ifndef TILEWORKER_H
+#define TILEWORKER_H
+
+/**
+ * Serves one tile of width x height pixels of a multi-process dual decomposition on the
+ * connected stream socket fd, see TileProtocol.h for the messages. Runs until SHUTDOWN arrives
+ * or the coordinator goes away and returns the exit code for the worker process, whose main()
+ * is in TileWorkerMain.cpp.
+ *
+ * The tile is an ImageGraphPrimal over the tile image, created once per SETUP with the region
+ * model of the whole image. New parameters rebuild its costs on the existing nodes and edges,
+ * new seeds only update their terminal edges, and new multipliers only the seams, so cuts after
+ * the first are warm started.
+ */
+int runTileWorker(int fd, unsigned int width, unsigned int height);
+
+#endif // TILEWORKER_H
@@ -0,0 +1,33 @@
+/**
+ * Worker process of ImageGraphMultiProcess, started by the coordinator with its end of a
+ * connected socket pair and the size of its tile. Serves the tile until the coordinator
+ * shuts it down or goes away.
+ */
+
+#include "TileWorker.h"
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char *argv[])
+{
+    if(argc != 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " socketFileDescriptor tileWidth tileHeight" << std::endl;
+        std::cerr << "\tstarted by ImageGraphMultiProcess, not meant to be run by hand" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    long values[3];
+    for(int i = 0; i < 3; i++)
+    {
+        char* end = NULL;
+        values[i] = strtol(argv[i + 1], &end, 10);
+        if(*end != '\0' || values[i] < 0 || (i > 0 && values[i] == 0))
+        {
+            std::cerr << argv[0] << ": invalid argument " << argv[i + 1] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    return runTileWorker((int)values[0], (unsigned int)values[1], (unsigned int)values[2]);
+}
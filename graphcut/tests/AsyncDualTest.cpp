@@ -0,0 +1,70 @@
+/**
+ * Cuts with ImageGraphDual in asynchronous mode, with the subproblems in lockstep and
+ * allowed to run ahead of each other, and checks that the coordinator stops with a complete
+ * label image on which both subproblems agree at the seam.
+ */
+
+#include "ImageGraphDual.h"
+#include "TestProblem.h"
+
+namespace {
+
+const unsigned int WIDTH = 96;
+const unsigned int HEIGHT = 64;
+const unsigned int NUM_ITERATIONS = 200;
+
+const unsigned int MAX_STALENESS[] = { 0, 2 };
+
+bool checkStaleness(bool condition, const char* message, unsigned int maxStaleness)
+{
+    if(!check(condition, message))
+        std::cerr << "\twith maxStaleness " << maxStaleness << std::endl;
+    return condition;
+}
+
+} // namespace
+
+int main()
+{
+    ImageGraph::ImageArray image;
+    ImageGraph::ImageArray mask;
+    // the disc crosses the seam
+    createTestProblem(image, mask, WIDTH, HEIGHT);
+
+    bool ok = true;
+    for(unsigned int maxStaleness : MAX_STALENESS)
+    {
+        // integer capacities, so both halves cut their shared seam alike and can agree exactly
+        ImageGraphDual dual(image, mask);
+        dual.setLoggingEnabled(false);
+        dual.setCapacityType(ImageGraphPrimal::INT32_CAPACITIES);
+        dual.setNumIterations(NUM_ITERATIONS);
+        dual.setAsynchronous(true);
+        dual.setMaxStaleness(maxStaleness);
+        dual.buildGraph();
+        const ImageGraph::ImageArray& labels = dual.runMinCut();
+
+        ok &= checkStaleness(labels.shape() == image.shape(), "the label image does not cover the image", maxStaleness);
+
+        bool binary = true;
+        bool hasForeground = false;
+        bool hasBackground = false;
+        for(unsigned int y = 0; y < labels.shape(1); y++)
+        {
+            for(unsigned int x = 0; x < labels.shape(0); x++)
+            {
+                binary &= (labels(x, y) == 0 || labels(x, y) == 255);
+                hasForeground |= (labels(x, y) != 0);
+                hasBackground |= (labels(x, y) == 0);
+            }
+        }
+        ok &= checkStaleness(binary, "a pixel is neither foreground nor background", maxStaleness);
+        ok &= checkStaleness(hasForeground && hasBackground, "the disc was not segmented", maxStaleness);
+        ok &= checkStaleness(labels(WIDTH / 2, HEIGHT / 2) != 0, "a foreground seed was labeled background", maxStaleness);
+        ok &= checkStaleness(labels(0, 0) == 0, "a background seed was labeled foreground", maxStaleness);
+
+        ok &= checkStaleness(dual.numDisagreements() == 0, "the subproblems still disagree at the seam", maxStaleness);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
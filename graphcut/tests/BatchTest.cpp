@@ -0,0 +1,100 @@
+/**
+ * Solves a batch of patches of mixed sizes and parameters with ImageGraphBatch and checks
+ * that every cut equals that of ImageGraphPrimal on the same patch.
+ */
+
+#include "ImageGraphBatch.h"
+#include "ImageGraphPrimal.h"
+#include "TestProblem.h"
+
+namespace {
+
+struct Patch {
+    unsigned int width;
+    unsigned int height;
+    float lambda;
+    float sigma;
+    int noiseAmplitude;
+};
+
+// sizes alternate, so solve() has to sort them to reuse its graphs. The last patch has no
+// noise, all seeds of a class have the same intensity and their variance is clamped.
+const Patch PATCHES[] = {
+    { 24, 16, 1.0f, 10.0f, 20 },
+    { 40, 32, 1.0f, 10.0f, 20 },
+    { 24, 16, 2.0f, 5.0f, 30 },
+    { 32, 40, 0.5f, 10.0f, 20 },
+    { 40, 32, 1.0f, 20.0f, 40 },
+    { 24, 16, 1.0f, 10.0f, 10 },
+    { 32, 32, 1.0f, 10.0f, 0 }
+};
+const unsigned int NUM_PATCHES = sizeof(PATCHES) / sizeof(PATCHES[0]);
+
+} // namespace
+
+int main()
+{
+    ImageGraphBatch batch;
+    std::vector<ImageGraph::ImageArray> images(NUM_PATCHES);
+    std::vector<ImageGraph::ImageArray> masks(NUM_PATCHES);
+    bool ok = true;
+
+    for(unsigned int i = 0; i < NUM_PATCHES; i++)
+    {
+        const Patch& patch = PATCHES[i];
+        createTestProblem(images[i], masks[i], patch.width, patch.height, 1000 + i, patch.noiseAmplitude);
+        ok &= check(batch.addProblem(images[i], masks[i], patch.lambda, patch.sigma) == i, "problems are not numbered in order");
+    }
+
+    // a class with a single seed has no model and is rejected without changing the batch
+    ImageGraph::ImageArray image;
+    ImageGraph::ImageArray mask;
+    createTestProblem(image, mask, 24, 16);
+    mask.init(PixelMask::NONE);
+    mask(2, 2) = PixelMask::BACKGROUND;
+    mask(3, 2) = PixelMask::BACKGROUND;
+    mask(12, 8) = PixelMask::FOREGROUND;
+    bool rejected = false;
+    try
+    {
+        batch.addProblem(image, mask, 1.0f, 10.0f);
+    }
+    catch(const std::exception&)
+    {
+        rejected = true;
+    }
+    ok &= check(rejected, "a problem with a single foreground seed was accepted");
+    ok &= check(batch.numProblems() == NUM_PATCHES, "a rejected problem was added");
+
+    batch.solve(2);
+    const ImageGraphBatch::LabelTensor& labels = batch.labels();
+
+    for(unsigned int i = 0; i < NUM_PATCHES; i++)
+    {
+        ImageGraphPrimal primal(images[i], masks[i]);
+        primal.setLoggingEnabled(false);
+        primal.setLambda(PATCHES[i].lambda);
+        primal.setSigma(PATCHES[i].sigma);
+        primal.buildGraph();
+        const ImageGraph::ImageArray& reference = primal.runMinCut();
+
+        bool equal = true;
+        bool hasForeground = false;
+        for(unsigned int y = 0; y < labels.shape(1); y++)
+        {
+            for(unsigned int x = 0; x < labels.shape(0); x++)
+            {
+                bool inside = x < PATCHES[i].width && y < PATCHES[i].height;
+                vigra::UInt8 expected = inside ? reference(x, y) : 0;
+                equal &= (labels(x, y, i) == expected);
+                hasForeground |= (expected != 0);
+            }
+        }
+
+        if(!check(equal, "labels differ from ImageGraphPrimal"))
+            std::cerr << "\tin problem " << i << " of size " << PATCHES[i].width << "x" << PATCHES[i].height << std::endl;
+        ok &= check(hasForeground, "the disc was not segmented");
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
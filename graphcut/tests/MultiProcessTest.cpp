@@ -0,0 +1,106 @@
+/**
+ * Kills tile workers of ImageGraphMultiProcess between cuts and adds seeds, and checks that
+ * the workers are restarted or updated and the cut still equals that of ImageGraphDual.
+ * With three tiles, checks that the middle one meets both neighbors and the cut equals
+ * that of ImageGraphPrimal.
+ *
+ * Usage: MultiProcessTest workerExecutable
+ */
+
+#include "ImageGraphDual.h"
+#include "ImageGraphMultiProcess.h"
+#include "ImageGraphPrimal.h"
+#include "TestProblem.h"
+#include <csignal>
+
+namespace {
+
+const unsigned int WIDTH = 96;
+const unsigned int HEIGHT = 64;
+const unsigned int NUM_ITERATIONS = 10;
+const unsigned int NUM_ITERATIONS_THREE_TILES = 100;
+
+// both continue from their last multipliers, so they are always cut together
+bool cutBoth(ImageGraphDual& dual, ImageGraphMultiProcess& multiProcess, const char* message)
+{
+    dual.buildGraph();
+    multiProcess.buildGraph();
+    return check(multiProcess.runMinCut() == dual.runMinCut(), message);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if(argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " workerExecutable" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    ImageGraph::ImageArray image;
+    ImageGraph::ImageArray mask;
+    // the disc crosses the seam
+    createTestProblem(image, mask, WIDTH, HEIGHT);
+
+    ImageGraphDual dual(image, mask);
+    dual.setLoggingEnabled(false);
+    dual.setNumIterations(NUM_ITERATIONS);
+
+    ImageGraphMultiProcess multiProcess(image, mask);
+    multiProcess.setLoggingEnabled(false);
+    multiProcess.setWorkerExecutable(argv[1]);
+    multiProcess.setNumIterations(NUM_ITERATIONS);
+
+    bool ok = cutBoth(dual, multiProcess, "labels differ from ImageGraphDual");
+    ok &= check(multiProcess.numWorkerRestarts() == 0, "a worker was restarted without failing");
+
+    // each worker dies in turn, the next cut finds it gone while solving and restarts it
+    for(unsigned int tile = 0; tile < multiProcess.numTiles(); tile++)
+    {
+        pid_t pid = multiProcess.workerProcessId(tile);
+        ok &= check(pid > 0, "worker is not running");
+        kill(pid, SIGKILL);
+
+        ok &= cutBoth(dual, multiProcess, "labels differ from ImageGraphDual after a restart");
+        ok &= check(multiProcess.numWorkerRestarts() == tile + 1, "the killed worker was not restarted exactly once");
+        ok &= check(multiProcess.workerProcessId(tile) != pid, "the killed worker is still registered");
+    }
+
+    // a foreground scribble across the seam reaches the running workers as new seeds only
+    std::vector<ImageGraph::Coordinate> scribble;
+    for(unsigned int x = WIDTH / 2 - 10; x < WIDTH / 2 + 10; x++)
+        scribble.push_back(ImageGraph::Coordinate(x, 8));
+    dual.addSeeds(scribble, PixelMask::FOREGROUND);
+    multiProcess.addSeeds(scribble, PixelMask::FOREGROUND);
+    ok &= cutBoth(dual, multiProcess, "labels differ from ImageGraphDual after adding seeds");
+
+    // a restarted worker gets them with its setup
+    kill(multiProcess.workerProcessId(1), SIGKILL);
+    ok &= cutBoth(dual, multiProcess, "labels differ from ImageGraphDual after a restart with new seeds");
+    ok &= check(multiProcess.numWorkerRestarts() == 3, "the killed worker was not restarted exactly once");
+
+    // the middle tile has a seam on both ends, each with its own multipliers
+    ImageGraphPrimal primal(image, mask);
+    primal.setLoggingEnabled(false);
+    primal.buildGraph();
+    const ImageGraph::ImageArray& primalLabels = primal.runMinCut();
+
+    ImageGraphMultiProcess threeTiles(image, mask, 3);
+    threeTiles.setLoggingEnabled(false);
+    threeTiles.setWorkerExecutable(argv[1]);
+    threeTiles.setNumIterations(NUM_ITERATIONS_THREE_TILES);
+    threeTiles.buildGraph();
+    ok &= check(threeTiles.numTiles() == 3, "the image was not split into three tiles");
+    ok &= check(threeTiles.runMinCut() == primalLabels, "labels of three tiles differ from ImageGraphPrimal");
+    ok &= check(threeTiles.numDisagreements() == 0, "three tiles still disagree at their seams");
+
+    pid_t pid = threeTiles.workerProcessId(1);
+    kill(pid, SIGKILL);
+    threeTiles.buildGraph();
+    ok &= check(threeTiles.runMinCut() == primalLabels, "labels of three tiles differ after restarting the middle one");
+    ok &= check(threeTiles.numWorkerRestarts() == 1 && threeTiles.workerProcessId(1) != pid,
+                "the killed middle worker was not restarted exactly once");
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+/**
+ * Cuts the same problem with float and integer capacities and checks that the integer cuts
+ * match the float reference, that a warm started cut equals a cold one on the same
+ * capacities, and that ImageGraphDual and ImageGraphPrimal agree under quantization.
+ */
+
+#include "ImageGraphDual.h"
+#include "ImageGraphPrimal.h"
+#include "TestProblem.h"
+
+namespace {
+
+const unsigned int WIDTH = 96;
+const unsigned int HEIGHT = 64;
+const unsigned int NUM_ITERATIONS = 50;
+
+const ImageGraphPrimal::CapacityType INTEGER_TYPES[] = {
+    ImageGraphPrimal::INT32_CAPACITIES,
+    ImageGraphPrimal::INT16_CAPACITIES
+};
+
+const char* typeName(ImageGraphPrimal::CapacityType capacityType)
+{
+    return capacityType == ImageGraphPrimal::INT16_CAPACITIES ? "int16" : "int32";
+}
+
+bool checkType(bool condition, const char* message, ImageGraphPrimal::CapacityType capacityType)
+{
+    if(!check(condition, message))
+        std::cerr << "\twith " << typeName(capacityType) << " capacities" << std::endl;
+    return condition;
+}
+
+} // namespace
+
+int main()
+{
+    ImageGraph::ImageArray image;
+    ImageGraph::ImageArray mask;
+    createTestProblem(image, mask, WIDTH, HEIGHT);
+
+    ImageGraphPrimal reference(image, mask);
+    reference.setLoggingEnabled(false);
+    reference.buildGraph();
+    ImageGraph::ImageArray referenceLabels = reference.runMinCut();
+
+    // outside the disc, so it changes the cut
+    std::vector<ImageGraph::Coordinate> scribble;
+    for(unsigned int x = WIDTH / 2 - 10; x < WIDTH / 2 + 10; x++)
+        scribble.push_back(ImageGraph::Coordinate(x, 8));
+
+    bool ok = true;
+    for(ImageGraphPrimal::CapacityType capacityType : INTEGER_TYPES)
+    {
+        ImageGraphPrimal primal(image, mask);
+        primal.setLoggingEnabled(false);
+        primal.setCapacityType(capacityType);
+        primal.buildGraph();
+        // half the largest scale, so the seeds added below cannot lower it
+        double scale = 0.5 * primal.capacityScale();
+        primal.setCapacityScale(scale);
+        ImageGraph::ImageArray labels = primal.runMinCut();
+        ok &= checkType(labels == referenceLabels, "labels differ from the float cut", capacityType);
+
+        // the seeds are cut warm started from the last flow, then the same capacities again from scratch
+        primal.addSeeds(scribble, PixelMask::FOREGROUND);
+        ImageGraph::ImageArray warmLabels = primal.runMinCut();
+        ok &= checkType(warmLabels != labels, "the scribble did not change the cut", capacityType);
+
+        primal.setCapacityType(ImageGraphPrimal::FLOAT_CAPACITIES);
+        primal.setCapacityType(capacityType);
+        ok &= checkType(primal.capacityScale() == scale, "the scale of the capacities changed", capacityType);
+        ok &= checkType(primal.runMinCut() == warmLabels, "warm started and cold cut differ", capacityType);
+
+        // both halves quantize their shared seam alike, so the dual reaches the primal cut
+        ImageGraphPrimal quantizedPrimal(image, mask);
+        quantizedPrimal.setLoggingEnabled(false);
+        quantizedPrimal.setCapacityType(capacityType);
+        quantizedPrimal.buildGraph();
+
+        ImageGraphDual dual(image, mask);
+        dual.setLoggingEnabled(false);
+        dual.setCapacityType(capacityType);
+        dual.setNumIterations(NUM_ITERATIONS);
+        dual.buildGraph();
+        ok &= checkType(dual.runMinCut() == quantizedPrimal.runMinCut(), "ImageGraphDual and ImageGraphPrimal differ", capacityType);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
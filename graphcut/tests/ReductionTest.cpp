@@ -0,0 +1,59 @@
+/**
+ * Cuts the same seeded image with and without graph reduction, before and after adding
+ * seeds incrementally, and checks that both give the same labels.
+ */
+
+#include "ImageGraphPrimal.h"
+#include "TestProblem.h"
+
+namespace {
+
+const unsigned int WIDTH = 96;
+const unsigned int HEIGHT = 64;
+
+bool cutBoth(ImageGraphPrimal& reduced, ImageGraphPrimal& full, const char* message)
+{
+    const ImageGraph::ImageArray& fullLabels = full.runMinCut();
+    return check(reduced.runMinCut() == fullLabels, message);
+}
+
+} // namespace
+
+int main()
+{
+    ImageGraph::ImageArray image;
+    ImageGraph::ImageArray mask;
+    createTestProblem(image, mask, WIDTH, HEIGHT);
+
+    ImageGraphPrimal reduced(image, mask);
+    reduced.setLoggingEnabled(false);
+    reduced.setGraphReductionEnabled(true);
+    reduced.buildGraph();
+
+    ImageGraphPrimal full(image, mask);
+    full.setLoggingEnabled(false);
+    full.setGraphReductionEnabled(false);
+    full.buildGraph();
+
+    bool ok = cutBoth(reduced, full, "reduced and full cut differ");
+
+    // a foreground scribble outside the disc, then a background one inside it. Both only
+    // update the terminal edges of their pixels, the reduced graph is derived again.
+    std::vector<ImageGraph::Coordinate> foregroundScribble;
+    for(unsigned int x = WIDTH / 2 - 10; x < WIDTH / 2 + 10; x++)
+        foregroundScribble.push_back(ImageGraph::Coordinate(x, 8));
+    reduced.addSeeds(foregroundScribble, PixelMask::FOREGROUND);
+    full.addSeeds(foregroundScribble, PixelMask::FOREGROUND);
+    ok &= cutBoth(reduced, full, "reduced and full cut differ after adding foreground seeds");
+    ok &= check(full.cutImage()(WIDTH / 2, 8) != 0, "the foreground scribble was not labeled foreground");
+
+    std::vector<ImageGraph::Coordinate> backgroundScribble;
+    for(unsigned int y = HEIGHT / 2 - 12; y < HEIGHT / 2 - 6; y++)
+        backgroundScribble.push_back(ImageGraph::Coordinate(WIDTH / 2 + 10, y));
+    reduced.addSeeds(backgroundScribble, PixelMask::BACKGROUND);
+    full.addSeeds(backgroundScribble, PixelMask::BACKGROUND);
+    ok &= cutBoth(reduced, full, "reduced and full cut differ after adding background seeds");
+    ok &= check(full.cutImage()(WIDTH / 2 + 10, HEIGHT / 2 - 8) == 0, "the background scribble was not labeled background");
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,50 @@
+#ifndef TESTPROBLEM_H
+#define TESTPROBLEM_H
+
+/**
+ * Synthetic segmentation problem and checks shared by the tests.
+ */
+
+#include "ImageGraph.h"
+#include <cstdlib>
+
+// bright disc in the center of a dark background, with deterministic noise of the given
+// amplitude. Foreground seeds in the middle of the disc, background seeds along the border.
+inline void createTestProblem(ImageGraph::ImageArray& image, ImageGraph::ImageArray& mask,
+                              unsigned int width, unsigned int height,
+                              unsigned int randomSeed = 12345, int noiseAmplitude = 20)
+{
+    image.reshape(vigra::Shape2(width, height), 0);
+    mask.reshape(vigra::Shape2(width, height), PixelMask::NONE);
+
+    int radius = std::min(width, height) * 5 / 16;
+    int seedRadius = (radius + 3) / 4;
+
+    unsigned int random = randomSeed;
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            random = random * 1103515245 + 12345;
+            int noise = (int)((random >> 16) % (2 * noiseAmplitude + 1)) - noiseAmplitude;
+            int dx = (int)x - (int)width / 2;
+            int dy = (int)y - (int)height / 2;
+            int value = (dx * dx + dy * dy < radius * radius) ? 190 : 60;
+            image(x, y) = value + noise;
+
+            if(std::abs(dx) < seedRadius && std::abs(dy) < seedRadius)
+                mask(x, y) = PixelMask::FOREGROUND;
+            else if(x < 3 || y < 3 || x >= width - 3 || y >= height - 3)
+                mask(x, y) = PixelMask::BACKGROUND;
+        }
+    }
+}
+
+inline bool check(bool condition, const char* message)
+{
+    if(!condition)
+        std::cerr << "FAILED: " << message << std::endl;
+    return condition;
+}
+
+#endif // TESTPROBLEM_H